@@ -0,0 +1,83 @@
+#version 460
+#extension GL_EXT_buffer_reference : require
+#extension GL_EXT_buffer_reference_uvec2 : require
+
+layout (location = 0) out vec3 out_color;
+layout (location = 1) out vec2 out_uv;
+
+struct Vertex {
+    vec3 position;
+    float uv_x;
+    vec3 normal;
+    float uv_y;
+    vec4 color;
+};
+
+struct PackedVertex {
+    uint position_xy;
+    uint position_z;
+    uint normal;
+    uint uv;
+    uint color;
+};
+
+// matches GPUDrawObject
+struct DrawObject {
+    mat4 world;
+    vec4 sphere;
+    uint lod_first_index[4];
+    uint lod_index_count[4];
+    float lod_error[4];
+    int base_vertex;
+    uint lod_count;
+    uint bucket;
+    uint command_base;
+    uint vertex_format;
+    uint pad0;
+    uint pad1;
+    uint pad2;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer {
+    Vertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer PackedVertexBuffer {
+    PackedVertex vertices[];
+};
+
+layout(buffer_reference, std430) readonly buffer ObjectBuffer {
+    DrawObject objects[];
+};
+
+layout(push_constant) uniform constants {
+    mat4 view_proj;
+    ObjectBuffer objects;
+    // read as either vertex layout depending on the object
+    uvec2 vertex_buffer;
+} PushConstants;
+
+const uint VERTEX_FORMAT_PACKED = 1;
+
+void main() {
+    mat4 world = PushConstants.objects.objects[gl_InstanceIndex].world;
+    uint vertex_format =
+        PushConstants.objects.objects[gl_InstanceIndex].vertex_format;
+
+    vec3 position;
+    if (vertex_format == VERTEX_FORMAT_PACKED) {
+        PackedVertex v =
+            PackedVertexBuffer(PushConstants.vertex_buffer).vertices[gl_VertexIndex];
+        position = vec3(unpackUnorm2x16(v.position_xy),
+                        unpackUnorm2x16(v.position_z).x);
+        out_color = unpackUnorm4x8(v.color).xyz;
+        out_uv = unpackHalf2x16(v.uv);
+    } else {
+        Vertex v = VertexBuffer(PushConstants.vertex_buffer).vertices[gl_VertexIndex];
+        position = v.position;
+        out_color = v.color.xyz;
+        out_uv = vec2(v.uv_x, v.uv_y);
+    }
+
+    gl_Position = PushConstants.view_proj * world * vec4(position, 1.0f);
+}
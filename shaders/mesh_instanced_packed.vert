@@ -0,0 +1,46 @@
+#version 450
+#extension GL_EXT_buffer_reference : require
+
+layout (location = 0) out vec3 out_color;
+layout (location = 1) out vec2 out_uv;
+
+// matches PackedVertex, 20 bytes
+struct PackedVertex {
+    uint position_xy;
+    uint position_z;
+    uint normal;
+    uint uv;
+    uint color;
+};
+
+layout(buffer_reference, std430) readonly buffer VertexBuffer{
+    PackedVertex vertices[];
+};
+
+// matches GPUInstanceData
+struct Instance {
+    mat4 world;
+};
+
+layout(buffer_reference, std430) readonly buffer InstanceBuffer{
+    Instance instances[];
+};
+
+layout(push_constant) uniform constants {
+    mat4 view_proj;
+    VertexBuffer vertex_buffer;
+    InstanceBuffer instance_buffer;
+} PushConstants;
+
+void main() {
+    PackedVertex v = PushConstants.vertex_buffer.vertices[gl_VertexIndex];
+    // world carries the dequantization into the mesh bounds
+    mat4 world = PushConstants.instance_buffer.instances[gl_InstanceIndex].world;
+
+    vec3 position = vec3(unpackUnorm2x16(v.position_xy),
+                         unpackUnorm2x16(v.position_z).x);
+
+    gl_Position = PushConstants.view_proj * world * vec4(position, 1.0f);
+    out_color = unpackUnorm4x8(v.color).xyz;
+    out_uv = unpackHalf2x16(v.uv);
+}
@@ -0,0 +1,103 @@
+#include "vk_import.h"
+#include "vk_jobs.h"
+#include "vk_mesh_cache.h"
+
+#include <atomic>
+
+// offline asset cooker, bakes every mesh source below a directory into the
+// cache format the engine maps at load time.
+//
+// usage: graphi_cook [source dir or file] [cache dir] [--force]
+//                    [--no-meshlets]
+// defaults to cooking assets/ into cache/, sources whose cache was baked
+// from the same file contents with the same options are skipped unless
+// --force is given
+int main(int argc, char **argv) {
+    std::filesystem::path source_root = "assets";
+    std::filesystem::path cache_root = "cache";
+    bool force = false;
+    MeshOptOptions options;
+
+    int positional = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg = argv[i];
+        if (arg == "--force") {
+            force = true;
+        } else if (arg == "--no-meshlets") {
+            options.build_meshlets = false;
+        } else if (positional == 0) {
+            source_root = arg;
+            positional++;
+        } else if (positional == 1) {
+            cache_root = arg;
+            positional++;
+        } else {
+            fmt::println("usage: graphi_cook [source] [cache dir] [--force] "
+                         "[--no-meshlets]");
+            return 1;
+        }
+    }
+
+    auto is_mesh_source = [](const std::filesystem::path &path) {
+        std::filesystem::path ext = path.extension();
+        return ext == ".glb" || ext == ".gltf" || ext == ".obj";
+    };
+
+    std::vector<std::filesystem::path> sources;
+    if (std::filesystem::is_regular_file(source_root)) {
+        sources.push_back(source_root);
+        source_root = source_root.parent_path();
+    } else if (std::filesystem::is_directory(source_root)) {
+        for (const auto &entry :
+             std::filesystem::recursive_directory_iterator(source_root)) {
+            if (entry.is_regular_file() && is_mesh_source(entry.path())) {
+                sources.push_back(entry.path());
+            }
+        }
+    } else {
+        fmt::println("No such source: {}", source_root.string());
+        return 1;
+    }
+
+    jobs::init();
+
+    std::atomic<uint32_t> cooked{0};
+    std::atomic<uint32_t> up_to_date{0};
+    std::atomic<uint32_t> failed{0};
+
+    jobs::parallel_for(sources.size(), [&](size_t i) {
+        const std::filesystem::path &source = sources[i];
+        std::filesystem::path output =
+            mesh_cache_path(source, source_root, cache_root);
+
+        uint64_t source_hash = hash_asset_source(source);
+
+        if (!force) {
+            MeshCache existing;
+            if (existing.open(output, source_hash, options)) {
+                up_to_date++;
+                return;
+            }
+        }
+
+        std::optional<ImportedAsset> asset = import_asset(source, options);
+        if (!asset || !write_mesh_cache(output, source_hash, options,
+                                        asset->meshes, asset->nodes)) {
+            fmt::println("Failed to cook: {}", source.string());
+            failed++;
+            return;
+        }
+
+        fmt::println("Cooked {} -> {} ({} meshes, {} nodes)", source.string(),
+                     output.string(), asset->meshes.size(),
+                     asset->nodes.size());
+        cooked++;
+    });
+
+    fmt::println("{} cooked, {} up to date, {} failed", cooked.load(),
+                 up_to_date.load(), failed.load());
+
+    jobs::shutdown();
+
+    return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,80 @@
+#include "vk_cull.h"
+#include "vk_jobs.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+// the simd and threaded culling paths against the scalar one, on the cpu
+// only. aborts on the first failed check
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,        \
+                         __LINE__, #cond);                                     \
+            std::abort();                                                      \
+        }                                                                      \
+    } while (0)
+
+// objects inside, outside and across the frustum planes, large enough
+// that many straddle one
+static BoundsTable random_table(size_t count, std::mt19937 &rng) {
+    std::uniform_real_distribution<float> lateral(-600.f, 600.f);
+    std::uniform_real_distribution<float> depth(-1100.f, 100.f);
+    std::uniform_real_distribution<float> size(0.5f, 40.f);
+
+    BoundsTable table;
+    for (size_t i = 0; i < count; i++) {
+        glm::vec3 center{lateral(rng), lateral(rng) * 0.5f, depth(rng)};
+        glm::vec3 extent{size(rng), size(rng), size(rng)};
+
+        Bounds bounds;
+        bounds.min = center - extent;
+        bounds.max = center + extent;
+        bounds.center = center;
+        bounds.radius = glm::length(extent);
+        table.add(bounds);
+    }
+
+    return table;
+}
+
+int main() {
+    jobs::init(4);
+
+    std::mt19937 rng(1234);
+    std::vector<uint32_t> reference;
+    std::vector<uint32_t> visible;
+
+    for (float fov : {40.f, 70.f, 110.f}) {
+        Frustum frustum = extract_frustum(
+            glm::perspective(glm::radians(fov), 16.f / 9.f, 0.1f, 1000.f));
+
+        // sizes around the 8 and 4 row steps for the tails, and enough
+        // rows for cull_frustum to split into chunks
+        for (size_t count : {0, 1, 3, 4, 5, 7, 8, 9, 12, 15, 16, 17, 1000,
+                             100'003}) {
+            BoundsTable table = random_table(count, rng);
+
+            cull_frustum_scalar(table, frustum, reference);
+            if (count >= 1000) {
+                // culled some and kept some, otherwise nothing was compared
+                CHECK(!reference.empty());
+                CHECK(reference.size() < count);
+            }
+
+            cull_frustum_simd(table, frustum, visible);
+            CHECK(visible == reference);
+
+            cull_frustum(table, frustum, visible);
+            CHECK(visible == reference);
+        }
+    }
+
+    jobs::shutdown();
+
+    std::printf("culling tests passed\n");
+    return 0;
+}
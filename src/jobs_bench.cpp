@@ -0,0 +1,27 @@
+#include "vk_jobs.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// task throughput and steal rate of the job scheduler, without a device.
+//
+// usage: graphi_jobs_bench [worker count]
+// worker count defaults to one per hardware thread minus the caller
+int main(int argc, char **argv) {
+    uint32_t worker_count = argc > 1 ? (uint32_t)std::atoi(argv[1]) : 0;
+    jobs::init(worker_count);
+
+    std::printf("%u workers\n", jobs::worker_count());
+    for (const jobs::BenchmarkResult &result : jobs::benchmark()) {
+        double steal_rate =
+            result.task_count > 0
+                ? (double)result.steals / (double)result.task_count
+                : 0.0;
+        std::printf("%-6s %8llu tasks %10.0f tasks/ms %6.1f%% stolen\n",
+                    result.name, (unsigned long long)result.task_count,
+                    result.tasks_per_ms, steal_rate * 100.0);
+    }
+
+    jobs::shutdown();
+    return 0;
+}
@@ -0,0 +1,178 @@
+#include "vk_jobs.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// checks of the job scheduler, standard library only so it runs without a
+// device. aborts on the first failed check, exit() would tear the
+// scheduler down under the running workers
+#define CHECK(cond)                                                            \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__,        \
+                         __LINE__, #cond);                                     \
+            std::abort();                                                      \
+        }                                                                      \
+    } while (0)
+
+// keeps a task busy long enough for idle workers to come and steal
+static void spin(std::chrono::microseconds duration) {
+    auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+static void run_runs_every_task_once() {
+    constexpr uint32_t task_count = 100000;
+    std::vector<std::atomic<uint32_t>> runs(task_count);
+
+    jobs::Counter counter;
+    for (uint32_t i = 0; i < task_count; i++) {
+        jobs::run([&runs, i]() { runs[i]++; }, &counter);
+    }
+    jobs::wait(counter);
+
+    CHECK(counter.pending.load() == 0);
+    for (uint32_t i = 0; i < task_count; i++) {
+        CHECK(runs[i].load() == 1);
+    }
+}
+
+static void parallel_for_runs_every_index_once() {
+    for (size_t count : {0, 1, 2, 7, 1000, 100000}) {
+        std::vector<std::atomic<uint32_t>> runs(count);
+        jobs::parallel_for(count, [&](size_t i) { runs[i]++; });
+
+        for (size_t i = 0; i < count; i++) {
+            CHECK(runs[i].load() == 1);
+        }
+    }
+}
+
+static void run_after_waits_for_the_counter() {
+    constexpr uint32_t task_count = 64;
+
+    for (int round = 0; round < 50; round++) {
+        std::atomic<uint32_t> done{0};
+        std::atomic<uint32_t> seen_done{0};
+        std::atomic<uint32_t> continuation_runs{0};
+
+        jobs::Counter first;
+        for (uint32_t i = 0; i < task_count; i++) {
+            jobs::run(
+                [&]() {
+                    spin(std::chrono::microseconds(20));
+                    done++;
+                },
+                &first);
+        }
+
+        jobs::Counter second;
+        jobs::run_after(
+            first,
+            [&]() {
+                seen_done = done.load();
+                continuation_runs++;
+            },
+            &second);
+
+        jobs::wait(second);
+        jobs::wait(first);
+
+        CHECK(continuation_runs.load() == 1);
+        CHECK(seen_done.load() == task_count);
+    }
+
+    // a counter that already drained runs the continuation right away
+    jobs::Counter drained;
+    std::atomic<bool> ran{false};
+    jobs::Counter after;
+    jobs::run_after(drained, [&]() { ran = true; }, &after);
+    jobs::wait(after);
+    CHECK(ran.load());
+}
+
+static void wait_inside_a_job_helps() {
+    // more waiting jobs than workers, if waiting blocked instead of
+    // helping every worker would sit in wait with the children queued
+    uint32_t outer_count = jobs::worker_count() * 4 + 4;
+    constexpr uint32_t inner_count = 32;
+    std::atomic<uint32_t> inner_runs{0};
+
+    jobs::Counter outer;
+    for (uint32_t i = 0; i < outer_count; i++) {
+        jobs::run(
+            [&]() {
+                jobs::Counter inner;
+                for (uint32_t j = 0; j < inner_count; j++) {
+                    jobs::run([&]() { inner_runs++; }, &inner);
+                }
+                jobs::wait(inner);
+            },
+            &outer);
+    }
+    jobs::wait(outer);
+
+    CHECK(inner_runs.load() == outer_count * inner_count);
+}
+
+static void nested_parallel_for_finishes() {
+    constexpr size_t outer_count = 64;
+    constexpr size_t inner_count = 256;
+    std::vector<std::atomic<uint32_t>> runs(outer_count * inner_count);
+
+    jobs::parallel_for(outer_count, [&](size_t i) {
+        jobs::parallel_for(inner_count,
+                           [&](size_t j) { runs[i * inner_count + j]++; });
+    });
+
+    for (const std::atomic<uint32_t> &r : runs) {
+        CHECK(r.load() == 1);
+    }
+}
+
+static void spawn(uint32_t depth, jobs::Counter *counter) {
+    spin(std::chrono::microseconds(10));
+    if (depth == 0) {
+        return;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        jobs::run([=]() { spawn(depth - 1, counter); }, counter);
+    }
+}
+
+static void uneven_load_is_stolen() {
+    // everything starts from one task, its children land in the deque of
+    // whichever worker runs it and the rest only get work by stealing
+    jobs::reset_stats();
+
+    jobs::Counter counter;
+    jobs::run([&]() { spawn(12, &counter); }, &counter);
+    jobs::wait(counter);
+
+    jobs::Stats stats = jobs::stats();
+    CHECK(stats.tasks_run == (1u << 13) - 1);
+    CHECK(stats.steals > 0);
+    CHECK(stats.steal_attempts >= stats.steals);
+}
+
+int main() {
+    // a fixed count, the steal check needs more than one worker even on
+    // a single core machine
+    jobs::init(4);
+
+    run_runs_every_task_once();
+    parallel_for_runs_every_index_once();
+    run_after_waits_for_the_counter();
+    wait_inside_a_job_helps();
+    nested_parallel_for_finishes();
+    uneven_load_is_stolen();
+
+    jobs::shutdown();
+
+    std::printf("jobs tests passed\n");
+    return 0;
+}
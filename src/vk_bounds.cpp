@@ -0,0 +1,179 @@
+#include "vk_bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GRAPHI_SSE 1
+#endif
+
+Bounds compute_bounds(const float *x, const float *y, const float *z,
+                      size_t count) {
+    Bounds bounds = {};
+    if (count == 0) {
+        return bounds;
+    }
+
+    float min[3] = {x[0], y[0], z[0]};
+    float max[3] = {x[0], y[0], z[0]};
+    const float *axes[3] = {x, y, z};
+
+    for (int a = 0; a < 3; a++) {
+        const float *values = axes[a];
+        size_t i = 0;
+
+#ifdef GRAPHI_SSE
+        if (count >= 4) {
+            __m128 lo = _mm_loadu_ps(values);
+            __m128 hi = lo;
+            for (i = 4; i + 4 <= count; i += 4) {
+                __m128 v = _mm_loadu_ps(values + i);
+                lo = _mm_min_ps(lo, v);
+                hi = _mm_max_ps(hi, v);
+            }
+
+            alignas(16) float lanes_lo[4];
+            alignas(16) float lanes_hi[4];
+            _mm_store_ps(lanes_lo, lo);
+            _mm_store_ps(lanes_hi, hi);
+            for (int l = 0; l < 4; l++) {
+                min[a] = std::min(min[a], lanes_lo[l]);
+                max[a] = std::max(max[a], lanes_hi[l]);
+            }
+        }
+#endif
+
+        for (; i < count; i++) {
+            min[a] = std::min(min[a], values[i]);
+            max[a] = std::max(max[a], values[i]);
+        }
+    }
+
+    bounds.min = {min[0], min[1], min[2]};
+    bounds.max = {max[0], max[1], max[2]};
+
+    // box center, not the tightest sphere but close enough for culling
+    bounds.center = (bounds.min + bounds.max) * 0.5f;
+
+    float cx = bounds.center.x;
+    float cy = bounds.center.y;
+    float cz = bounds.center.z;
+    float radius_sq = 0.f;
+    size_t i = 0;
+
+#ifdef GRAPHI_SSE
+    __m128 best = _mm_setzero_ps();
+    __m128 vcx = _mm_set1_ps(cx);
+    __m128 vcy = _mm_set1_ps(cy);
+    __m128 vcz = _mm_set1_ps(cz);
+    for (; i + 4 <= count; i += 4) {
+        __m128 dx = _mm_sub_ps(_mm_loadu_ps(x + i), vcx);
+        __m128 dy = _mm_sub_ps(_mm_loadu_ps(y + i), vcy);
+        __m128 dz = _mm_sub_ps(_mm_loadu_ps(z + i), vcz);
+        __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)),
+                              _mm_mul_ps(dz, dz));
+        best = _mm_max_ps(best, d);
+    }
+
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, best);
+    for (int l = 0; l < 4; l++) {
+        radius_sq = std::max(radius_sq, lanes[l]);
+    }
+#endif
+
+    for (; i < count; i++) {
+        float dx = x[i] - cx;
+        float dy = y[i] - cy;
+        float dz = z[i] - cz;
+        radius_sq = std::max(radius_sq, dx * dx + dy * dy + dz * dz);
+    }
+
+    bounds.radius = std::sqrt(radius_sq);
+
+    return bounds;
+}
+
+Bounds merge_bounds(const Bounds &a, const Bounds &b) {
+    Bounds merged;
+    merged.min = glm::min(a.min, b.min);
+    merged.max = glm::max(a.max, b.max);
+    merged.center = (merged.min + merged.max) * 0.5f;
+
+    // both spheres have to fit around the new center
+    merged.radius =
+        std::max(glm::length(a.center - merged.center) + a.radius,
+                 glm::length(b.center - merged.center) + b.radius);
+
+    return merged;
+}
+
+Bounds transform_bounds(const Bounds &bounds, const glm::mat4 &transform) {
+    Bounds result;
+
+    // box corners through the matrix, one axis at a time (Arvo 1990)
+    glm::vec3 translation = glm::vec3(transform[3]);
+    result.min = translation;
+    result.max = translation;
+    for (int c = 0; c < 3; c++) {
+        for (int r = 0; r < 3; r++) {
+            float a = transform[c][r] * bounds.min[c];
+            float b = transform[c][r] * bounds.max[c];
+            result.min[r] += std::min(a, b);
+            result.max[r] += std::max(a, b);
+        }
+    }
+
+    // the sphere grows with the largest axis scale
+    result.center = glm::vec3(transform * glm::vec4(bounds.center, 1.f));
+    result.radius = bounds.radius * max_axis_scale(transform);
+
+    return result;
+}
+
+float max_axis_scale(const glm::mat4 &transform) {
+    return std::max(glm::length(glm::vec3(transform[0])),
+                    std::max(glm::length(glm::vec3(transform[1])),
+                             glm::length(glm::vec3(transform[2]))));
+}
+
+uint32_t BoundsTable::add(const Bounds &bounds) {
+    uint32_t row = (uint32_t)size();
+
+    center_x.push_back(bounds.center.x);
+    center_y.push_back(bounds.center.y);
+    center_z.push_back(bounds.center.z);
+    radius.push_back(bounds.radius);
+
+    min_x.push_back(bounds.min.x);
+    min_y.push_back(bounds.min.y);
+    min_z.push_back(bounds.min.z);
+    max_x.push_back(bounds.max.x);
+    max_y.push_back(bounds.max.y);
+    max_z.push_back(bounds.max.z);
+
+    return row;
+}
+
+void BoundsTable::set(uint32_t row, const Bounds &bounds) {
+    center_x[row] = bounds.center.x;
+    center_y[row] = bounds.center.y;
+    center_z[row] = bounds.center.z;
+    radius[row] = bounds.radius;
+
+    min_x[row] = bounds.min.x;
+    min_y[row] = bounds.min.y;
+    min_z[row] = bounds.min.z;
+    max_x[row] = bounds.max.x;
+    max_y[row] = bounds.max.y;
+    max_z[row] = bounds.max.z;
+}
+
+void BoundsTable::clear() {
+    for (std::vector<float> *column :
+         {&center_x, &center_y, &center_z, &radius, &min_x, &min_y, &min_z,
+          &max_x, &max_y, &max_z}) {
+        column->clear();
+    }
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "vk_types.h"
+
+// bounds over points given as separate x, y and z arrays, the box is
+// reduced four points at a time with sse
+Bounds compute_bounds(const float *x, const float *y, const float *z,
+                      size_t count);
+
+Bounds merge_bounds(const Bounds &a, const Bounds &b);
+
+// box and sphere enclosing the transformed bounds
+Bounds transform_bounds(const Bounds &bounds, const glm::mat4 &transform);
+
+// largest factor the transform stretches a length by
+float max_axis_scale(const glm::mat4 &transform);
+
+// bounds of every renderable as structure of arrays, culling streams
+// through these instead of chasing MeshAsset pointers
+class BoundsTable {
+  public:
+    std::vector<float> center_x;
+    std::vector<float> center_y;
+    std::vector<float> center_z;
+    std::vector<float> radius;
+
+    std::vector<float> min_x;
+    std::vector<float> min_y;
+    std::vector<float> min_z;
+    std::vector<float> max_x;
+    std::vector<float> max_y;
+    std::vector<float> max_z;
+
+    // returns the row of the new entry
+    uint32_t add(const Bounds &bounds);
+    void set(uint32_t row, const Bounds &bounds);
+    void clear();
+
+    size_t size() const { return radius.size(); }
+};
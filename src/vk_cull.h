@@ -0,0 +1,42 @@
+#pragma once
+
+#include "vk_bounds.h"
+
+// world space planes as (normal, distance), a point p is inside a plane
+// when dot(normal, p) + distance >= 0
+struct Frustum {
+    glm::vec4 planes[6];
+};
+
+// planes of a view projection matrix (Gribb and Hartmann 2001). near and
+// far are taken as -w <= z <= w, which also holds for a 0..1 depth range
+Frustum extract_frustum(const glm::mat4 &view_proj);
+
+// every cull_frustum variant replaces visible with the rows of bounds
+// whose sphere and box both touch the frustum, in ascending order
+
+// one row at a time, the reference the simd paths are checked against
+void cull_frustum_scalar(const BoundsTable &bounds, const Frustum &frustum,
+                         std::vector<uint32_t> &visible);
+
+// 4 rows per step with sse, 8 with avx when the cpu has it
+void cull_frustum_simd(const BoundsTable &bounds, const Frustum &frustum,
+                       std::vector<uint32_t> &visible);
+
+// simd path, split into chunks across the job system once the table is
+// large enough to pay for it
+void cull_frustum(const BoundsTable &bounds, const Frustum &frustum,
+                  std::vector<uint32_t> &visible);
+
+struct CullBenchmarkResult {
+    size_t object_count;
+    // objects tested per millisecond, best of a few runs
+    double scalar_rate;
+    double simd_rate;
+    double threaded_rate;
+    size_t visible_count;
+};
+
+// random spheres and boxes around a fixed camera at 10k, 100k and 1M
+// objects, every variant is checked against the scalar result
+std::vector<CullBenchmarkResult> benchmark_culling();
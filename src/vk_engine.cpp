@@ -13,25 +13,52 @@
 
 #include <VkBootstrap.h>
 
+#include <algorithm>
+#include <chrono>
+
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 
+#include "vk_cull.h"
 #include "vk_descriptors.h"
 #include "vk_init.h"
+#include "vk_jobs.h"
 #include "vk_pipelines.h"
 #include "vk_types.h"
 #include "vk_util.h"
 
 constexpr bool use_validation_layers = true;
 
+// watched for changed shaders while running
+constexpr const char *shader_dir = "shaders";
+
+// driver compiled pipelines, reused across runs on the same device and
+// driver
+constexpr const char *pipeline_cache_path = "cache/pipelines.bin";
+
+// runs below this many per chunk record faster on one thread than spread
+// over secondaries
+constexpr size_t min_runs_per_chunk = 256;
+
 VulkanEngine *loaded_engine = nullptr;
 
 VulkanEngine &VulkanEngine::Get() { return *loaded_engine; }
 
+// placement of cell z * grid_size + x of the scene grid
+static glm::mat4 grid_cell_transform(int cell, int grid_size) {
+    int x = cell % grid_size;
+    int z = cell / grid_size;
+    return glm::translate(
+        glm::vec3{(x - grid_size / 2) * 3.f, 0.f, z * -3.f});
+}
+
 void VulkanEngine::init() {
     assert(loaded_engine == nullptr);
 
     loaded_engine = this;
+
+    jobs::init();
+
     SDL_Init(SDL_INIT_VIDEO);
     SDL_WindowFlags window_flags =
         (SDL_WindowFlags)(SDL_WINDOW_VULKAN | SDL_WINDOW_RESIZABLE);
@@ -49,6 +76,8 @@ void VulkanEngine::init() {
 
     init_descriptors();
 
+    init_depth_pyramid();
+
     init_pipelines();
 
     init_imgui();
@@ -99,6 +128,7 @@ void VulkanEngine::init_imgui() {
     init_info.ColorAttachmentFormat = swapchain_img_format;
 
     init_info.MSAASamples = VK_SAMPLE_COUNT_1_BIT;
+    init_info.PipelineCache = pipeline_cache;
 
     ImGui_ImplVulkan_Init(&init_info, VK_NULL_HANDLE);
 
@@ -138,12 +168,21 @@ void VulkanEngine::init_vulkan() {
     VkPhysicalDeviceVulkan12Features features12{};
     features12.bufferDeviceAddress = true;
     features12.descriptorIndexing = true;
+    features12.timelineSemaphore = true;
+    features12.drawIndirectCount = true;
+    features12.samplerFilterMinmax = true;
+
+    // 1.0 features, indirect draws carry the object index in firstInstance
+    VkPhysicalDeviceFeatures features10{};
+    features10.multiDrawIndirect = true;
+    features10.drawIndirectFirstInstance = true;
 
     vkb::PhysicalDeviceSelector selector{vkb_inst};
     vkb::PhysicalDevice physical_device =
         selector.set_minimum_version(1, 3)
             .set_required_features_13(features)
             .set_required_features_12(features12)
+            .set_required_features(features10)
             .set_surface(surface)
             .select()
             .value();
@@ -158,6 +197,21 @@ void VulkanEngine::init_vulkan() {
     graphics_queue_family =
         vkb_device.get_queue_index(vkb::QueueType::graphics).value();
 
+    // uploads run beside rendering when there is a transfer only family
+    auto dedicated_transfer =
+        vkb_device.get_dedicated_queue(vkb::QueueType::transfer);
+    if (dedicated_transfer) {
+        transfer_queue = dedicated_transfer.value();
+        transfer_queue_family =
+            vkb_device.get_dedicated_queue_index(vkb::QueueType::transfer)
+                .value();
+    } else {
+        transfer_queue = graphics_queue;
+        transfer_queue_family = graphics_queue_family;
+    }
+    fmt::println("Transfer queue family: {} (graphics: {})",
+                 transfer_queue_family, graphics_queue_family);
+
     VmaAllocatorCreateInfo alloc_info = {};
     alloc_info.physicalDevice = active_gpu;
     alloc_info.device = device;
@@ -209,6 +263,7 @@ void VulkanEngine::init_swapchain() {
     depth_img.img_extent = draw_img.img_extent;
     VkImageUsageFlags depth_image_usages{};
     depth_image_usages |= VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+    depth_image_usages |= VK_IMAGE_USAGE_SAMPLED_BIT;
 
     // depth image create info
     VkImageCreateInfo dimg_info = vkinit::img_create_info(
@@ -251,6 +306,30 @@ void VulkanEngine::init_commands() {
 
         VK_CHECK(vkAllocateCommandBuffers(device, &cmd_alloc_info,
                                           &frames[i].main_command_buffer));
+
+        // reset as a whole every frame, the command buffers are never reset
+        // one by one
+        VkCommandPoolCreateInfo recording_pool_info =
+            vkinit::command_pool_create_info(
+                graphics_queue_family,
+                VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+
+        uint32_t slot_count =
+            std::min(jobs::worker_count() + 1, max_recording_slots);
+        frames[i].recording_pools.resize(slot_count);
+        frames[i].recording_command_buffers.resize(slot_count);
+        for (uint32_t s = 0; s < slot_count; s++) {
+            VK_CHECK(vkCreateCommandPool(device, &recording_pool_info, nullptr,
+                                         &frames[i].recording_pools[s]));
+
+            VkCommandBufferAllocateInfo secondary_alloc_info =
+                vkinit::command_buffer_allocate_info(
+                    frames[i].recording_pools[s], 1,
+                    VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+            VK_CHECK(vkAllocateCommandBuffers(
+                device, &secondary_alloc_info,
+                &frames[i].recording_command_buffers[s]));
+        }
     }
 
     // immediate submit
@@ -266,6 +345,12 @@ void VulkanEngine::init_commands() {
     main_deletion_queue.push_func([=, this]() {
         vkDestroyCommandPool(device, imm_command_pool, nullptr);
     });
+
+    // batched uploads
+    uploader.init(device, alloc, transfer_queue, transfer_queue_family,
+                  64 * 1024 * 1024);
+
+    main_deletion_queue.push_func([&]() { uploader.destroy(); });
 }
 
 void VulkanEngine::init_sync_structures() {
@@ -291,10 +376,12 @@ void VulkanEngine::init_sync_structures() {
 }
 
 void VulkanEngine::init_descriptors() {
+    // room for the draw image, every depth pyramid level and the cull set
     std::vector<DescriptorAllocator::PoolSizeRatio> sizes = {
-        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1}};
+        {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1},
+        {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1}};
 
-    global_descriptor_allocator.init_pool(device, 10, sizes);
+    global_descriptor_allocator.init_pool(device, 32, sizes);
 
     {
         DescriptorLayoutBuilder builder;
@@ -303,6 +390,21 @@ void VulkanEngine::init_descriptors() {
             builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT);
     }
 
+    {
+        DescriptorLayoutBuilder builder;
+        builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+        builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        depth_reduce_descriptor_layout =
+            builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+
+    {
+        DescriptorLayoutBuilder builder;
+        builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+        cull_descriptor_layout =
+            builder.build(device, VK_SHADER_STAGE_COMPUTE_BIT);
+    }
+
     draw_img_descriptors = global_descriptor_allocator.allocate(
         device, draw_img_descriptor_layout);
 
@@ -321,18 +423,268 @@ void VulkanEngine::init_descriptors() {
     draw_img_write.pImageInfo = &img_info;
 
     vkUpdateDescriptorSets(device, 1, &draw_img_write, 0, nullptr);
+
+    main_deletion_queue.push_func([&]() {
+        vkDestroyDescriptorSetLayout(device, depth_reduce_descriptor_layout,
+                                     nullptr);
+        vkDestroyDescriptorSetLayout(device, cull_descriptor_layout, nullptr);
+    });
+}
+
+static uint32_t previous_pow2(uint32_t value) {
+    uint32_t result = 1;
+    while (result * 2 <= value) {
+        result *= 2;
+    }
+    return result;
+}
+
+void VulkanEngine::init_depth_pyramid() {
+    // power of two so every level is exactly half the one above
+    depth_pyramid_width = previous_pow2(draw_img.img_extent.width);
+    depth_pyramid_height = previous_pow2(draw_img.img_extent.height);
+    depth_pyramid_levels = 1;
+    while ((depth_pyramid_width >> depth_pyramid_levels) > 0 ||
+           (depth_pyramid_height >> depth_pyramid_levels) > 0) {
+        depth_pyramid_levels++;
+    }
+    depth_pyramid_levels =
+        std::min(depth_pyramid_levels, max_depth_pyramid_levels);
+
+    depth_pyramid.img_format = VK_FORMAT_R32_SFLOAT;
+    depth_pyramid.img_extent = {depth_pyramid_width, depth_pyramid_height, 1};
+
+    VkImageCreateInfo img_info = vkinit::img_create_info(
+        depth_pyramid.img_format,
+        VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+        depth_pyramid.img_extent);
+    img_info.mipLevels = depth_pyramid_levels;
+
+    VmaAllocationCreateInfo img_alloc_info = {};
+    img_alloc_info.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+    img_alloc_info.requiredFlags =
+        VkMemoryPropertyFlags(VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+
+    VK_CHECK(vmaCreateImage(alloc, &img_info, &img_alloc_info,
+                            &depth_pyramid.img, &depth_pyramid.allocation,
+                            nullptr));
+
+    VkImageViewCreateInfo view_info = vkinit::imgview_create_info(
+        depth_pyramid.img_format, depth_pyramid.img, VK_IMAGE_ASPECT_COLOR_BIT);
+    view_info.subresourceRange.levelCount = depth_pyramid_levels;
+
+    VK_CHECK(vkCreateImageView(device, &view_info, nullptr,
+                               &depth_pyramid.img_view));
+
+    for (uint32_t i = 0; i < depth_pyramid_levels; i++) {
+        view_info.subresourceRange.baseMipLevel = i;
+        view_info.subresourceRange.levelCount = 1;
+
+        VK_CHECK(vkCreateImageView(device, &view_info, nullptr,
+                                   &depth_pyramid_mips[i]));
+    }
+
+    // a linear tap returns the smallest, so furthest, of the 2x2 texels
+    VkSamplerReductionModeCreateInfo reduction_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_REDUCTION_MODE_CREATE_INFO};
+    reduction_info.reductionMode = VK_SAMPLER_REDUCTION_MODE_MIN;
+
+    VkSamplerCreateInfo sampler_info = {
+        .sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO};
+    sampler_info.pNext = &reduction_info;
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.minLod = 0.f;
+    sampler_info.maxLod = (float)depth_pyramid_levels;
+
+    VK_CHECK(vkCreateSampler(device, &sampler_info, nullptr,
+                             &depth_reduce_sampler));
+
+    for (uint32_t i = 0; i < depth_pyramid_levels; i++) {
+        depth_reduce_descriptors[i] = global_descriptor_allocator.allocate(
+            device, depth_reduce_descriptor_layout);
+
+        VkDescriptorImageInfo dst_info{};
+        dst_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+        dst_info.imageView = depth_pyramid_mips[i];
+
+        VkDescriptorImageInfo src_info{};
+        src_info.sampler = depth_reduce_sampler;
+        if (i == 0) {
+            src_info.imageLayout = VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+            src_info.imageView = depth_img.img_view;
+        } else {
+            src_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+            src_info.imageView = depth_pyramid_mips[i - 1];
+        }
+
+        VkWriteDescriptorSet writes[2] = {};
+        writes[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[0].dstBinding = 0;
+        writes[0].dstSet = depth_reduce_descriptors[i];
+        writes[0].descriptorCount = 1;
+        writes[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        writes[0].pImageInfo = &dst_info;
+
+        writes[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[1].dstBinding = 1;
+        writes[1].dstSet = depth_reduce_descriptors[i];
+        writes[1].descriptorCount = 1;
+        writes[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        writes[1].pImageInfo = &src_info;
+
+        vkUpdateDescriptorSets(device, 2, writes, 0, nullptr);
+    }
+
+    cull_descriptors =
+        global_descriptor_allocator.allocate(device, cull_descriptor_layout);
+
+    VkDescriptorImageInfo pyramid_info{};
+    pyramid_info.sampler = depth_reduce_sampler;
+    pyramid_info.imageLayout = VK_IMAGE_LAYOUT_GENERAL;
+    pyramid_info.imageView = depth_pyramid.img_view;
+
+    VkWriteDescriptorSet pyramid_write = {};
+    pyramid_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+    pyramid_write.dstBinding = 0;
+    pyramid_write.dstSet = cull_descriptors;
+    pyramid_write.descriptorCount = 1;
+    pyramid_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+    pyramid_write.pImageInfo = &pyramid_info;
+
+    vkUpdateDescriptorSets(device, 1, &pyramid_write, 0, nullptr);
+
+    main_deletion_queue.push_func([&]() {
+        vkDestroySampler(device, depth_reduce_sampler, nullptr);
+        for (uint32_t i = 0; i < depth_pyramid_levels; i++) {
+            vkDestroyImageView(device, depth_pyramid_mips[i], nullptr);
+        }
+        vkDestroyImageView(device, depth_pyramid.img_view, nullptr);
+        vmaDestroyImage(alloc, depth_pyramid.img, depth_pyramid.allocation);
+    });
 }
 
 void VulkanEngine::init_pipelines() {
+    init_pipeline_cache();
+
+    // after the cache so it runs before the cache is saved
+    main_deletion_queue.push_func(
+        [&]() { pipeline_registry.destroy(device); });
+
+    auto start = std::chrono::steady_clock::now();
+
+    // the init functions only create layouts and describe their pipelines,
+    // the driver compiles all of them at once on the job workers below.
+    // nothing is drawn before this returns
+    PipelineBatch batch;
+
     // compute
-    init_background_pipelines();
+    init_background_pipelines(batch);
 
     // graphics
-    init_triangle_pipeline();
-    init_mesh_pipeline();
+    init_triangle_pipeline(batch);
+    init_mesh_pipeline(batch);
+
+    init_indirect_pipelines(batch);
+
+    size_t pipeline_count = batch.size();
+    uint32_t failed =
+        batch.compile(device, pipeline_cache, &pipeline_registry);
+    if (failed > 0) {
+        fmt::println("{} of {} pipelines failed to build", failed,
+                     pipeline_count);
+    }
+
+    PipelineRegistryStats registry_stats = pipeline_registry.stats();
+    fmt::println("Pipeline registry: {} built, {} reused, {} shader modules "
+                 "loaded, {} reused",
+                 registry_stats.misses, registry_stats.hits,
+                 registry_stats.shader_module_loads,
+                 registry_stats.shader_module_hits);
+
+    auto end = std::chrono::steady_clock::now();
+    pipeline_build_ms =
+        std::chrono::duration<float, std::milli>(end - start).count();
+    fmt::println("Built {} pipelines in {:.1f} ms on {} threads with a {} "
+                 "cache",
+                 pipeline_count, pipeline_build_ms, jobs::worker_count() + 1,
+                 pipeline_cache_warm ? "warm" : "cold");
+
+    if (shader_watcher.init(shader_dir)) {
+        main_deletion_queue.push_func([&]() { shader_watcher.destroy(); });
+    } else {
+        fmt::println("Cannot watch {}, shader hot reload is off", shader_dir);
+    }
 }
 
-void VulkanEngine::init_background_pipelines() {
+void VulkanEngine::reload_shaders() {
+    for (const std::filesystem::path &path : shader_watcher.poll()) {
+        if (is_glsl_source(path)) {
+            // off the frame, the .spv it writes comes back through the
+            // watcher and is reloaded then
+            jobs::run([path]() {
+                if (!compile_glsl(path)) {
+                    fmt::println("Failed to compile {}", path.string());
+                }
+            });
+            continue;
+        }
+
+        if (path.extension() != ".spv") {
+            continue;
+        }
+
+        RetiredPipelineObjects retired;
+        uint32_t rebuilt;
+        if (!pipeline_registry.reload_shader(device, pipeline_cache,
+                                             path.string().c_str(), retired,
+                                             &rebuilt)) {
+            fmt::println("Failed to reload {}, keeping the old pipelines",
+                         path.string());
+            continue;
+        }
+
+        // the other frame may still be drawing with them. this queue is
+        // flushed after this frame's fence is next waited on, by then both
+        // frames are past them
+        get_current_frame().deletion_queue.push_func([=, this]() {
+            for (VkPipeline pipeline : retired.pipelines) {
+                vkDestroyPipeline(device, pipeline, nullptr);
+            }
+            for (VkShaderModule module : retired.shader_modules) {
+                vkDestroyShaderModule(device, module, nullptr);
+            }
+        });
+
+        if (!retired.shader_modules.empty()) {
+            shader_reloads++;
+            fmt::println("Reloaded {}, rebuilt {} pipelines", path.string(),
+                         rebuilt);
+        }
+    }
+}
+
+void VulkanEngine::init_pipeline_cache() {
+    pipeline_cache = vkutil::load_pipeline_cache(
+        device, active_gpu, pipeline_cache_path, &pipeline_cache_warm);
+
+    // queued before any pipeline, so it runs after they are all gone and
+    // the file holds everything built this run
+    main_deletion_queue.push_func([=, this]() {
+        if (!vkutil::save_pipeline_cache(device, active_gpu, pipeline_cache,
+                                         pipeline_cache_path)) {
+            fmt::println("Failed to write pipeline cache: {}",
+                         pipeline_cache_path);
+        }
+        vkDestroyPipelineCache(device, pipeline_cache, nullptr);
+    });
+}
+
+void VulkanEngine::init_background_pipelines(PipelineBatch &batch) {
     VkPipelineLayoutCreateInfo compute_layout = {};
     compute_layout.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     compute_layout.pNext = nullptr;
@@ -350,85 +702,217 @@ void VulkanEngine::init_background_pipelines() {
     VK_CHECK(vkCreatePipelineLayout(device, &compute_layout, nullptr,
                                     &gradient_pipeline_layout));
 
-    VkShaderModule gradient_shader;
-    if (!vkutil::loader_shader_module("shaders/gradient.comp.spv", device,
-                                      &gradient_shader)) {
-        fmt::println("Error when building the gradient shader\n");
-    }
-
-    VkShaderModule sky_shader;
-    if (!vkutil::loader_shader_module("shaders/sky.comp.spv", device,
-                                      &sky_shader)) {
-        fmt::println("Error when building the sky shader\n");
-    }
-
-    VkPipelineShaderStageCreateInfo stage_info = {};
-    stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    stage_info.pNext = nullptr;
-    stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    stage_info.module = gradient_shader;
-    stage_info.pName = "main";
-
-    VkComputePipelineCreateInfo compute_pipeline_create_info = {};
-    compute_pipeline_create_info.sType =
-        VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    compute_pipeline_create_info.pNext = nullptr;
-    compute_pipeline_create_info.layout = gradient_pipeline_layout;
-    compute_pipeline_create_info.stage = stage_info;
-
     ComputeEffect gradient;
     gradient.layout = gradient_pipeline_layout;
     gradient.name = "gradient";
+    gradient.shader_path = "shaders/gradient.comp.spv";
+    gradient.toggles = {{"horizontal", false}};
     gradient.data = {};
 
     // default colors
     gradient.data.data1 = glm::vec4(1, 0, 0, 1);
     gradient.data.data2 = glm::vec4(0, 0, 1, 1);
 
-    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1,
-                                      &compute_pipeline_create_info, nullptr,
-                                      &gradient.pipeline));
-
-    compute_pipeline_create_info.stage.module = sky_shader;
-
     ComputeEffect sky;
     sky.layout = gradient_pipeline_layout;
     sky.name = "sky";
+    sky.shader_path = "shaders/sky.comp.spv";
+    sky.toggles = {{"stars", true}};
     sky.data = {};
 
     // defaults
     sky.data.data1 = glm::vec4(0.1, 0.2, 0.4, 0.97);
 
-    VK_CHECK(vkCreateComputePipelines(device, VK_NULL_HANDLE, 1,
-                                      &compute_pipeline_create_info, nullptr,
-                                      &sky.pipeline));
-
+    // the batch writes the pipelines in place, so the effects have to be
+    // in their final spot first
+    size_t first_effect = background_effects.size();
     background_effects.push_back(gradient);
     background_effects.push_back(sky);
 
-    // cleanup
-    vkDestroyShaderModule(device, gradient_shader, nullptr);
-    vkDestroyShaderModule(device, sky_shader, nullptr);
+    for (size_t i = first_effect; i < background_effects.size(); i++) {
+        ComputeEffect &effect = background_effects[i];
+        batch.add(describe_effect(effect, effect.workgroup_size),
+                  &effect.pipeline);
+    }
 
     main_deletion_queue.push_func([&]() {
         vkDestroyPipelineLayout(device, gradient_pipeline_layout, nullptr);
-        vkDestroyPipeline(device, sky.pipeline, nullptr);
-        vkDestroyPipeline(device, gradient.pipeline, nullptr);
     });
 }
 
-void VulkanEngine::init_triangle_pipeline() {
+ComputePipelineDesc
+VulkanEngine::describe_effect(const ComputeEffect &effect,
+                              VkExtent2D workgroup_size) {
+    VkShaderModule shader;
+    if (!pipeline_registry.shader_module(device, effect.shader_path,
+                                         &shader)) {
+        fmt::println("Error when building the {} shader", effect.name);
+    }
+
+    ComputePipelineDesc desc = {};
+    desc.stage = vkinit::pipeline_shader_stage_create_info(
+        VK_SHADER_STAGE_COMPUTE_BIT, shader, "main");
+    desc.layout = effect.layout;
+
+    desc.set_constant(0, workgroup_size.width);
+    desc.set_constant(1, workgroup_size.height);
+    for (uint32_t i = 0; i < effect.toggles.size(); i++) {
+        desc.set_constant(2 + i,
+                          effect.toggles[i].enabled ? VK_TRUE : VK_FALSE);
+    }
+
+    return desc;
+}
+
+void VulkanEngine::build_effect_variant(ComputeEffect &effect) {
+    // variants stay in the registry, switching back to one is a lookup
+    VkPipeline pipeline = pipeline_registry.get(
+        device, pipeline_cache, describe_effect(effect, effect.workgroup_size));
+    if (pipeline == VK_NULL_HANDLE) {
+        fmt::println("Failed to build a {} variant, keeping the old one",
+                     effect.name);
+        return;
+    }
+
+    pipeline_registry.assign(&effect.pipeline, pipeline);
+}
+
+// sizes tried by tune_effect, the ones over the device limits are skipped
+constexpr VkExtent2D workgroup_size_candidates[] = {
+    {8, 8}, {16, 8}, {8, 16}, {16, 16}, {32, 8},
+    {8, 32}, {32, 16}, {64, 4}, {32, 32},
+};
+
+// dispatches timed per candidate, enough to drown the timestamp overhead
+constexpr uint32_t tune_dispatch_count = 16;
+
+void VulkanEngine::tune_effect(ComputeEffect &effect) {
+    VkPhysicalDeviceProperties properties;
+    vkGetPhysicalDeviceProperties(active_gpu, &properties);
+    const VkPhysicalDeviceLimits &limits = properties.limits;
+    if (!limits.timestampComputeAndGraphics) {
+        fmt::println("No timestamps on this device, cannot tune {}",
+                     effect.name);
+        return;
+    }
+
+    std::vector<VkExtent2D> sizes;
+    for (VkExtent2D size : workgroup_size_candidates) {
+        if (size.width <= limits.maxComputeWorkGroupSize[0] &&
+            size.height <= limits.maxComputeWorkGroupSize[1] &&
+            size.width * size.height <= limits.maxComputeWorkGroupInvocations) {
+            sizes.push_back(size);
+        }
+    }
+
+    std::vector<VkPipeline> variants(sizes.size());
+    jobs::parallel_for(sizes.size(), [&](size_t i) {
+        variants[i] = pipeline_registry.get(device, pipeline_cache,
+                                            describe_effect(effect, sizes[i]));
+    });
+
+    VkQueryPoolCreateInfo pool_info = {
+        .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO};
+    pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    pool_info.queryCount = (uint32_t)sizes.size() * 2;
+
+    VkQueryPool query_pool;
+    VK_CHECK(vkCreateQueryPool(device, &pool_info, nullptr, &query_pool));
+
+    // the frames in flight draw into the same image
+    vkDeviceWaitIdle(device);
+
+    immediate_submit([&](VkCommandBuffer cmd) {
+        vkCmdResetQueryPool(cmd, query_pool, 0, pool_info.queryCount);
+
+        vkutil::transition_img(cmd, draw_img.img, VK_IMAGE_LAYOUT_UNDEFINED,
+                               VK_IMAGE_LAYOUT_GENERAL);
+
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                effect.layout, 0, 1, &draw_img_descriptors, 0,
+                                nullptr);
+        vkCmdPushConstants(cmd, effect.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(ComputePushConstants), &effect.data);
+
+        for (uint32_t i = 0; i < sizes.size(); i++) {
+            if (variants[i] == VK_NULL_HANDLE) {
+                continue;
+            }
+
+            vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                              variants[i]);
+
+            // all commands, so each pair brackets only its own dispatches
+            vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                 query_pool, i * 2);
+            for (uint32_t d = 0; d < tune_dispatch_count; d++) {
+                vkCmdDispatch(cmd, (draw_img.img_extent.width +
+                                    sizes[i].width - 1) / sizes[i].width,
+                              (draw_img.img_extent.height +
+                               sizes[i].height - 1) / sizes[i].height,
+                              1);
+            }
+            vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT,
+                                 query_pool, i * 2 + 1);
+        }
+    });
+
+    std::vector<uint64_t> timestamps(pool_info.queryCount);
+    effect.timings.clear();
+
+    for (uint32_t i = 0; i < sizes.size(); i++) {
+        // queries of skipped variants were never written, waiting on them
+        // would not return
+        if (variants[i] == VK_NULL_HANDLE) {
+            continue;
+        }
+
+        VK_CHECK(vkGetQueryPoolResults(
+            device, query_pool, i * 2, 2, sizeof(uint64_t) * 2,
+            &timestamps[i * 2], sizeof(uint64_t),
+            VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT));
+
+        float ms = (timestamps[i * 2 + 1] - timestamps[i * 2]) *
+                   limits.timestampPeriod / 1e6f / tune_dispatch_count;
+        effect.timings.push_back({sizes[i], ms});
+
+        fmt::println("{} {}x{}: {:.3f} ms", effect.name, sizes[i].width,
+                     sizes[i].height, ms);
+    }
+
+    vkDestroyQueryPool(device, query_pool, nullptr);
+
+    if (effect.timings.empty()) {
+        fmt::println("No {} variant could be built to tune", effect.name);
+        return;
+    }
+
+    auto best = std::min_element(
+        effect.timings.begin(), effect.timings.end(),
+        [](const WorkgroupTiming &a, const WorkgroupTiming &b) {
+            return a.milliseconds < b.milliseconds;
+        });
+    effect.workgroup_size = best->size;
+    build_effect_variant(effect);
+
+    fmt::println("Tuned {} to {}x{}", effect.name, effect.workgroup_size.width,
+                 effect.workgroup_size.height);
+}
+
+void VulkanEngine::init_triangle_pipeline(PipelineBatch &batch) {
     VkShaderModule triangle_frag_shader;
-    if (!vkutil::loader_shader_module("shaders/colored_triangle.frag.spv",
-                                      device, &triangle_frag_shader)) {
+    if (!pipeline_registry.shader_module(
+            device, "shaders/colored_triangle.frag.spv",
+            &triangle_frag_shader)) {
         fmt::println("Error when building the triangle fragment shader module");
     } else {
         fmt::println("Triangle fragment shader loaded");
     }
 
     VkShaderModule triangle_vertex_shader;
-    if (!vkutil::loader_shader_module("shaders/colored_triangle.vert.spv",
-                                      device, &triangle_vertex_shader)) {
+    if (!pipeline_registry.shader_module(
+            device, "shaders/colored_triangle.vert.spv",
+            &triangle_vertex_shader)) {
         fmt::println("Error when building the triangle vertex shader module");
     } else {
         fmt::println("Triangle vertex shader loaded");
@@ -450,16 +934,12 @@ void VulkanEngine::init_triangle_pipeline() {
     pipeline_builder.disable_depthtest();
 
     pipeline_builder.set_color_attachment_format(draw_img.img_format);
-    pipeline_builder.set_depth_format(VK_FORMAT_UNDEFINED);
+    pipeline_builder.set_depth_format(depth_img.img_format);
 
-    triangle_pipeline = pipeline_builder.build_pipeline(device);
-
-    vkDestroyShaderModule(device, triangle_frag_shader, nullptr);
-    vkDestroyShaderModule(device, triangle_vertex_shader, nullptr);
+    batch.add(pipeline_builder.describe(), &triangle_pipeline);
 
     main_deletion_queue.push_func([&]() {
         vkDestroyPipelineLayout(device, triangle_pipeline_layout, nullptr);
-        vkDestroyPipeline(device, triangle_pipeline, nullptr);
     });
 }
 
@@ -495,11 +975,20 @@ void VulkanEngine::destroy_swapchain() {
 
 void VulkanEngine::cleanup() {
     if (is_init) {
+        // staged copies must land before the arena buffers go away
+        uploader.flush();
+
         vkDeviceWaitIdle(device);
+        for (int i = 0; i < FRAME_OVERLAP; i++) {
+            frames[i].deletion_queue.flush();
+        }
         main_deletion_queue.flush();
 
         for (int i = 0; i < FRAME_OVERLAP; i++) {
             vkDestroyCommandPool(device, frames[i].command_pool, nullptr);
+            for (VkCommandPool pool : frames[i].recording_pools) {
+                vkDestroyCommandPool(device, pool, nullptr);
+            }
 
             vkDestroyFence(device, frames[i].render_fence, nullptr);
             vkDestroySemaphore(device, frames[i].render_semaphore, nullptr);
@@ -517,6 +1006,8 @@ void VulkanEngine::cleanup() {
         SDL_DestroyWindow(window);
     }
 
+    jobs::shutdown();
+
     loaded_engine = nullptr;
 }
 
@@ -567,6 +1058,103 @@ void VulkanEngine::run() {
             ImGui::InputFloat4("data3", (float *)&selected.data.data3);
             ImGui::InputFloat4("data4", (float *)&selected.data.data4);
 
+            bool rebuild = false;
+            for (ComputeEffectToggle &toggle : selected.toggles) {
+                rebuild |= ImGui::Checkbox(toggle.name, &toggle.enabled);
+            }
+            if (rebuild) {
+                build_effect_variant(selected);
+            }
+
+            ImGui::Text("Workgroup size: %ux%u", selected.workgroup_size.width,
+                        selected.workgroup_size.height);
+            if (ImGui::Button("Auto-tune workgroup size")) {
+                tune_effect(selected);
+            }
+            for (const WorkgroupTiming &timing : selected.timings) {
+                ImGui::Text("%ux%u: %.3f ms", timing.size.width,
+                            timing.size.height, timing.milliseconds);
+            }
+
+            ImGui::End();
+        }
+
+        if (ImGui::Begin("geometry")) {
+            ImGui::Text("Pipelines built in %.1f ms, %s cache",
+                        pipeline_build_ms,
+                        pipeline_cache_warm ? "warm" : "cold");
+            PipelineRegistryStats registry_stats = pipeline_registry.stats();
+            ImGui::Text("Pipeline registry: %u built, %u reused",
+                        registry_stats.misses, registry_stats.hits);
+            ImGui::Text("Shader reloads: %u", shader_reloads);
+            ImGui::SliderFloat("LOD pixel error", &lod_pixel_error, 0.f, 16.f);
+
+            for (uint32_t i = 0; i < max_lod_count; i++) {
+                ImGui::Text("LOD %u triangles: %u", i, stats.lod_triangles[i]);
+            }
+
+            if (ImGui::SliderFloat("Scene rotation", &scene_rotation, -180.f,
+                                   180.f)) {
+                for (size_t i = 0; i < scene_roots.size(); i++) {
+                    scene.set_local(
+                        scene_roots[i],
+                        grid_cell_transform((int)i, scene_grid_size) *
+                            glm::rotate(glm::radians(scene_rotation),
+                                        glm::vec3{0.f, 1.f, 0.f}));
+                }
+            }
+            ImGui::Text("Scene nodes: %zu, surfaces: %zu", scene.size(),
+                        render_items.size());
+
+            ImGui::Checkbox("GPU driven", &gpu_driven);
+            if (gpu_driven) {
+                ImGui::Checkbox("Occlusion culling", &occlusion_culling);
+                ImGui::Text("Culling and LOD selection run on the GPU");
+            } else {
+                ImGui::Text("Visible surfaces: %u, culled: %u",
+                            stats.visible_items, stats.culled_items);
+                ImGui::Text("Instanced draw calls: %u", stats.draw_calls);
+                ImGui::Checkbox("Sort draws", &sort_draws);
+                ImGui::Checkbox("Parallel recording", &parallel_recording);
+            }
+            ImGui::Text("Binds: %u pipeline, %u descriptor set, %u index "
+                        "buffer",
+                        stats.binds.pipeline_binds,
+                        stats.binds.descriptor_set_binds,
+                        stats.binds.index_buffer_binds);
+
+            if (ImGui::Button("Benchmark culling")) {
+                cull_benchmark = benchmark_culling();
+            }
+            for (const CullBenchmarkResult &result : cull_benchmark) {
+                ImGui::Text("%zu objects: scalar %.0f/ms, simd %.0f/ms, "
+                            "threaded %.0f/ms",
+                            result.object_count, result.scalar_rate,
+                            result.simd_rate, result.threaded_rate);
+            }
+
+            if (ImGui::Button("Benchmark jobs")) {
+                job_benchmark = jobs::benchmark();
+            }
+            for (const jobs::BenchmarkResult &result : job_benchmark) {
+                ImGui::Text("%s: %llu tasks, %.0f/ms, %llu steals",
+                            result.name,
+                            (unsigned long long)result.task_count,
+                            result.tasks_per_ms,
+                            (unsigned long long)result.steals);
+            }
+
+            if (ImGui::Button("Benchmark recording")) {
+                record_benchmark = benchmark_recording();
+            }
+            for (const RecordBenchmarkResult &result : record_benchmark) {
+                ImGui::Text("%u draws on %u threads: %.2f ms (%.1fx)",
+                            result.draw_count, result.thread_count,
+                            result.milliseconds,
+                            record_benchmark[0].milliseconds /
+                                result.milliseconds);
+            }
+
             ImGui::End();
         }
         ImGui::Render();
@@ -581,6 +1169,12 @@ void VulkanEngine::draw() {
 
     get_current_frame().deletion_queue.flush();
 
+    reload_shaders();
+
+    // kick off anything staged since the last frame, the submit below waits
+    // on the timeline so meshes can be used before their copies finish
+    UploadHandle uploads = uploader.submit();
+
     uint32_t swapchain_img_index;
     VkResult err = vkAcquireNextImageKHR(
         device, swapchain, 1000000000, get_current_frame().swapchain_semaphore,
@@ -604,6 +1198,9 @@ void VulkanEngine::draw() {
 
     VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_begin_info));
 
+    update_camera();
+    update_scene(cmd);
+
     vkutil::transition_img(cmd, draw_img.img, VK_IMAGE_LAYOUT_UNDEFINED,
                            VK_IMAGE_LAYOUT_GENERAL);
 
@@ -611,6 +1208,8 @@ void VulkanEngine::draw() {
 
     vkutil::transition_img(cmd, draw_img.img, VK_IMAGE_LAYOUT_GENERAL,
                            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
+    vkutil::transition_img(cmd, depth_img.img, VK_IMAGE_LAYOUT_UNDEFINED,
+                           VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 
     draw_geometry(cmd);
 
@@ -640,15 +1239,21 @@ void VulkanEngine::draw() {
     VkCommandBufferSubmitInfo cmd_info =
         vkinit::command_buffer_submit_info(cmd);
 
-    VkSemaphoreSubmitInfo wait_info = vkinit::semaphore_submit_info(
+    VkSemaphoreSubmitInfo wait_info[2];
+    wait_info[0] = vkinit::semaphore_submit_info(
         VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR,
         get_current_frame().swapchain_semaphore);
+    wait_info[1] = vkinit::semaphore_submit_info(
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, uploader.timeline());
+    wait_info[1].value = uploads.value;
+
     VkSemaphoreSubmitInfo signal_info =
         vkinit::semaphore_submit_info(VK_PIPELINE_STAGE_2_ALL_GRAPHICS_BIT,
                                       get_current_frame().render_semaphore);
 
     VkSubmitInfo2 submit =
-        vkinit::submit_info(&cmd_info, &signal_info, &wait_info);
+        vkinit::submit_info(&cmd_info, &signal_info, &wait_info[0]);
+    submit.waitSemaphoreInfoCount = 2;
 
     VK_CHECK(vkQueueSubmit2(graphics_queue, 1, &submit,
                             get_current_frame().render_fence));
@@ -685,8 +1290,11 @@ void VulkanEngine::draw_background(VkCommandBuffer cmd) {
                        VK_SHADER_STAGE_COMPUTE_BIT, 0,
                        sizeof(ComputePushConstants), &effect.data);
 
-    vkCmdDispatch(cmd, std::ceil(draw_extent.width / 16.0),
-                  std::ceil(draw_extent.height / 16.0), 1);
+    vkCmdDispatch(cmd, std::ceil(draw_extent.width /
+                                 (double)effect.workgroup_size.width),
+                  std::ceil(draw_extent.height /
+                            (double)effect.workgroup_size.height),
+                  1);
 }
 
 void VulkanEngine::draw_imgui(VkCommandBuffer cmd,
@@ -728,16 +1336,278 @@ void VulkanEngine::immediate_submit(
     VK_CHECK(vkWaitForFences(device, 1, &imm_fence, true, 9999999999));
 }
 
-void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
+// coarsest level whose error projects to at most max_pixel_error pixels,
+// pixel_scale is the projected size in pixels of one unit at distance one
+// errors are in mesh units, error_scale takes them to world units like
+// the bounds row of the item
+static uint32_t select_lod(const GeoSurface &surface,
+                           const BoundsTable &bounds, uint32_t row,
+                           float error_scale, const glm::mat4 &view,
+                           float pixel_scale, float max_pixel_error) {
+    glm::vec4 center =
+        view * glm::vec4(bounds.center_x[row], bounds.center_y[row],
+                         bounds.center_z[row], 1.f);
+    float distance =
+        std::max(glm::length(glm::vec3(center)) - bounds.radius[row], 0.1f);
+
+    uint32_t lod = 0;
+    while (lod + 1 < surface.lod_count &&
+           surface.lods[lod + 1].error * error_scale * pixel_scale /
+                   distance <=
+               max_pixel_error) {
+        lod++;
+    }
+
+    return lod;
+}
+
+void VulkanEngine::update_camera() {
+    // viewport
+    camera_view = glm::translate(glm::vec3{0, 0, -5});
+
+    // camera, near and far swapped for reversed depth
+    float fov = glm::radians(70.f);
+    camera_znear = 0.1f;
+    camera_proj = glm::perspective(
+        fov, (float)draw_extent.width / (float)draw_extent.height, 10000.f,
+        camera_znear);
+    camera_pixel_scale = draw_extent.height / (2.f * std::tan(fov * 0.5f));
+
+    // invert the y axis
+    camera_proj[1][1] *= -1;
+}
+
+void VulkanEngine::cull_draws(VkCommandBuffer cmd, bool late) {
+    if (draw_object_count == 0) {
+        return;
+    }
+
+    // both passes of a frame share the parameters and the count reset
+    if (!late) {
+        glm::mat4 view_proj = camera_proj * camera_view;
+        Frustum frustum = extract_frustum(view_proj);
+
+        // fixed size regardless of the object count
+        GPUCullParams *params =
+            (GPUCullParams *)get_current_frame().cull_params.info.pMappedData;
+        for (int i = 0; i < 6; i++) {
+            params->frustum[i] = frustum.planes[i];
+        }
+        params->camera = glm::vec4(glm::vec3(glm::inverse(camera_view)[3]),
+                                   camera_pixel_scale);
+        params->view = camera_view;
+        params->projection = glm::vec4(camera_proj[0][0], camera_proj[1][1],
+                                       camera_proj[2][2], camera_proj[3][2]);
+        params->pyramid_width = (float)depth_pyramid_width;
+        params->pyramid_height = (float)depth_pyramid_height;
+        params->znear = camera_znear;
+        params->object_count = draw_object_count;
+        params->lod_pixel_error = lod_pixel_error;
+        params->occlusion_culling = occlusion_culling ? 1 : 0;
+
+        // last frame's indirect reads and visibility writes have to finish
+        // before the counts reset
+        VkMemoryBarrier2 reset_barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+        reset_barrier.srcStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT |
+                                     VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        reset_barrier.srcAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT |
+                                      VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+        reset_barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT |
+                                     VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        reset_barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT |
+                                      VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+
+        VkDependencyInfo dependency = {
+            .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+        dependency.memoryBarrierCount = 1;
+        dependency.pMemoryBarriers = &reset_barrier;
+        vkCmdPipelineBarrier2(cmd, &dependency);
+
+        vkCmdFillBuffer(cmd, draw_count_buffer.buffer, 0,
+                        2 * draw_buckets.size() * sizeof(uint32_t), 0);
+
+        VkMemoryBarrier2 fill_barrier = {
+            .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+        fill_barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+        fill_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+        fill_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+        fill_barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT |
+                                     VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+        dependency.pMemoryBarriers = &fill_barrier;
+        vkCmdPipelineBarrier2(cmd, &dependency);
+    }
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline);
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                            cull_pipeline_layout, 0, 1, &cull_descriptors, 0,
+                            nullptr);
+
+    // the late pass writes the second half of the commands and counts
+    GPUCullPushConstants push_constants;
+    push_constants.params =
+        get_buffer_address(get_current_frame().cull_params);
+    push_constants.objects = get_buffer_address(draw_object_buffer);
+    push_constants.commands =
+        get_buffer_address(draw_command_buffer) +
+        (late ? draw_object_count * sizeof(VkDrawIndexedIndirectCommand) : 0);
+    push_constants.counts =
+        get_buffer_address(draw_count_buffer) +
+        (late ? draw_buckets.size() * sizeof(uint32_t) : 0);
+    push_constants.visibility = get_buffer_address(draw_visibility_buffer);
+    push_constants.late = late ? 1 : 0;
+
+    vkCmdPushConstants(cmd, cull_pipeline_layout, VK_SHADER_STAGE_COMPUTE_BIT,
+                       0, sizeof(GPUCullPushConstants), &push_constants);
+    vkCmdDispatch(cmd, (draw_object_count + 63) / 64, 1, 1);
+
+    VkMemoryBarrier2 cull_barrier = {.sType =
+                                         VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    cull_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    cull_barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    cull_barrier.dstStageMask = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT;
+    cull_barrier.dstAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT;
+
+    VkDependencyInfo dependency = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dependency.memoryBarrierCount = 1;
+    dependency.pMemoryBarriers = &cull_barrier;
+    vkCmdPipelineBarrier2(cmd, &dependency);
+}
+
+void VulkanEngine::draw_indirect(VkCommandBuffer cmd, bool late) {
+    if (draw_object_count == 0) {
+        return;
+    }
+
+    bind_state.bind_pipeline(cmd, indirect_pipeline);
+
+    GPUIndirectPushConstants push_constants;
+    push_constants.view_proj = camera_proj * camera_view;
+    push_constants.objects = get_buffer_address(draw_object_buffer);
+
+    uint32_t command_offset = late ? draw_object_count : 0;
+    uint32_t count_offset = late ? (uint32_t)draw_buckets.size() : 0;
+
+    // one call per bucket, the cull pass decided how many draws each has
+    for (uint32_t b = 0; b < draw_buckets.size(); b++) {
+        const DrawBucket &bucket = draw_buckets[b];
+
+        push_constants.vertex_buffer = bucket.vertex_buffer_address;
+        vkCmdPushConstants(cmd, indirect_pipeline_layout,
+                           VK_SHADER_STAGE_VERTEX_BIT, 0,
+                           sizeof(GPUIndirectPushConstants), &push_constants);
+
+        bind_state.bind_index_buffer(cmd, bucket.index_buffer,
+                                     bucket.index_type);
+        vkCmdDrawIndexedIndirectCount(
+            cmd, draw_command_buffer.buffer,
+            (command_offset + bucket.command_base) *
+                sizeof(VkDrawIndexedIndirectCommand),
+            draw_count_buffer.buffer, (count_offset + b) * sizeof(uint32_t),
+            bucket.max_draw_count, sizeof(VkDrawIndexedIndirectCommand));
+    }
+}
+
+void VulkanEngine::build_depth_pyramid(VkCommandBuffer cmd) {
+    vkutil::transition_img(cmd, depth_img.img,
+                           VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL,
+                           VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL);
+    // rebuilt from scratch every frame
+    vkutil::transition_img(cmd, depth_pyramid.img, VK_IMAGE_LAYOUT_UNDEFINED,
+                           VK_IMAGE_LAYOUT_GENERAL);
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                      depth_reduce_pipeline);
+
+    VkMemoryBarrier2 level_barrier = {.sType =
+                                          VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    level_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    level_barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT;
+    level_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT;
+    level_barrier.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT;
+
+    VkDependencyInfo dependency = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dependency.memoryBarrierCount = 1;
+    dependency.pMemoryBarriers = &level_barrier;
+
+    for (uint32_t i = 0; i < depth_pyramid_levels; i++) {
+        uint32_t width = std::max(depth_pyramid_width >> i, 1u);
+        uint32_t height = std::max(depth_pyramid_height >> i, 1u);
+
+        vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE,
+                                depth_reduce_pipeline_layout, 0, 1,
+                                &depth_reduce_descriptors[i], 0, nullptr);
+
+        // level 0 reads the whole depth image, the rest the level above
+        glm::vec4 sizes = {(float)width, (float)height,
+                           (float)depth_img.img_extent.width,
+                           (float)depth_img.img_extent.height};
+        if (i > 0) {
+            sizes.z = (float)std::max(depth_pyramid_width >> (i - 1), 1u);
+            sizes.w = (float)std::max(depth_pyramid_height >> (i - 1), 1u);
+        }
+        vkCmdPushConstants(cmd, depth_reduce_pipeline_layout,
+                           VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(sizes),
+                           &sizes);
+        vkCmdDispatch(cmd, (width + 31) / 32, (height + 31) / 32, 1);
+
+        // the next level and the late cull pass sample this one
+        vkCmdPipelineBarrier2(cmd, &dependency);
+    }
+
+    vkutil::transition_img(cmd, depth_img.img,
+                           VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL,
+                           VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+}
+
+void VulkanEngine::begin_geometry_pass(VkCommandBuffer cmd, bool clear_depth,
+                                       VkRenderingFlags flags) {
     VkRenderingAttachmentInfo color_attachment = vkinit::attachment_info(
         draw_img.img_view, nullptr, VK_IMAGE_LAYOUT_GENERAL);
 
-    VkRenderingInfo render_info =
-        vkinit::rendering_info(draw_extent, &color_attachment, nullptr);
+    // reversed depth, so the far plane clears to 0
+    VkClearValue depth_clear = {};
+    depth_clear.depthStencil.depth = 0.f;
+    VkRenderingAttachmentInfo depth_attachment = vkinit::attachment_info(
+        depth_img.img_view, clear_depth ? &depth_clear : nullptr,
+        VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+
+    VkRenderingInfo render_info = vkinit::rendering_info(
+        draw_extent, &color_attachment, &depth_attachment);
+    render_info.flags = flags;
     vkCmdBeginRendering(cmd, &render_info);
 
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, triangle_pipeline);
+    // a pass made of secondaries takes nothing but vkCmdExecuteCommands,
+    // each secondary sets the viewport itself
+    if (!(flags & VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT)) {
+        set_draw_viewport(cmd);
+    }
+}
+
+// starts a secondary that continues the geometry pass
+void VulkanEngine::begin_geometry_secondary(VkCommandBuffer cmd) {
+    VkCommandBufferInheritanceRenderingInfo rendering_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO};
+    rendering_info.colorAttachmentCount = 1;
+    rendering_info.pColorAttachmentFormats = &draw_img.img_format;
+    rendering_info.depthAttachmentFormat = depth_img.img_format;
+    rendering_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkCommandBufferInheritanceInfo inheritance_info = {
+        .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO};
+    inheritance_info.pNext = &rendering_info;
+
+    VkCommandBufferBeginInfo begin_info = vkinit::command_buffer_begin_info(
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT |
+        VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT);
+    begin_info.pInheritanceInfo = &inheritance_info;
+    VK_CHECK(vkBeginCommandBuffer(cmd, &begin_info));
+
+    // dynamic state does not carry over from the primary
+    set_draw_viewport(cmd);
+}
 
+void VulkanEngine::set_draw_viewport(VkCommandBuffer cmd) {
     VkViewport viewport = {};
     viewport.x = 0;
     viewport.y = 0;
@@ -755,10 +1625,14 @@ void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
     scissor.extent.height = draw_extent.height;
 
     vkCmdSetScissor(cmd, 0, 1, &scissor);
+}
+
+void VulkanEngine::draw_debug_geometry(VkCommandBuffer cmd, BindState &binds) {
+    binds.bind_pipeline(cmd, triangle_pipeline);
 
     vkCmdDraw(cmd, 3, 1, 0, 0);
 
-    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, mesh_pipeline);
+    binds.bind_pipeline(cmd, mesh_pipeline);
 
     GPUDrawPushConstants push_constants;
     push_constants.world_matrix = glm::mat4{1.f};
@@ -766,36 +1640,292 @@ void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
 
     vkCmdPushConstants(cmd, mesh_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
                        sizeof(GPUDrawPushConstants), &push_constants);
-    vkCmdBindIndexBuffer(cmd, rectangle.index_buffer.buffer, 0,
-                         VK_INDEX_TYPE_UINT32);
+    binds.bind_index_buffer(cmd, rectangle.index_buffer, VK_INDEX_TYPE_UINT32);
 
-    vkCmdDrawIndexed(cmd, 6, 1, 0, 0, 0);
+    vkCmdDrawIndexed(cmd, 6, 1, rectangle.first_index, rectangle.base_vertex,
+                     0);
+}
 
-    // viewport
-    glm::mat4 view = glm::translate(glm::vec3{0, 0, -5});
+// culls the render items, picks their levels and keys the visible ones
+void VulkanEngine::build_render_queue() {
+    glm::mat4 view_proj = camera_proj * camera_view;
+
+    cull_frustum(render_bounds, extract_frustum(view_proj), visible_items);
+    stats.visible_items = (uint32_t)visible_items.size();
+    stats.culled_items = (uint32_t)(render_items.size() - visible_items.size());
+
+    render_queue.clear();
+    uint32_t no_set = render_queue.descriptor_set_id(VK_NULL_HANDLE);
+    for (uint32_t item_index : visible_items) {
+        const RenderItem &item = render_items[item_index];
+        const GPUMeshBuffers &mesh_buffers = item.mesh->mesh_buffers;
+        const GeoSurface &surface = item.mesh->surfaces[item.surface];
+
+        uint32_t lod = select_lod(surface, render_bounds, item_index,
+                                  max_axis_scale(item.transform), camera_view,
+                                  camera_pixel_scale, lod_pixel_error);
+
+        VkPipeline pipeline =
+            mesh_buffers.vertex_format == VertexFormat::Packed
+                ? mesh_instanced_packed_pipeline
+                : mesh_instanced_pipeline;
+        glm::vec4 center =
+            camera_view * glm::vec4(render_bounds.center_x[item_index],
+                                    render_bounds.center_y[item_index],
+                                    render_bounds.center_z[item_index], 1.f);
+
+        uint64_t key = make_sort_key(
+            render_queue.pipeline_id(pipeline), no_set,
+            render_queue.index_buffer_id(mesh_buffers.index_buffer,
+                                         surface.index_type),
+            item.surface_id * max_lod_count + lod, -center.z);
+        render_queue.push(key, item_index, lod);
+    }
+
+    // placements of the same surface at the same level end up next to
+    // each other and draw as one instanced call, each state once
+    if (sort_draws) {
+        render_queue.sort();
+    }
+    render_queue.find_runs();
+}
 
-    // camera
-    glm::mat4 projection = glm::perspective(
-        glm::radians(70.f),
-        (float)draw_extent.width / (float)draw_extent.height, 10000.f, 0.1f);
+// records runs [first_run, last_run) of queue. only touches cmd, binds,
+// draw_stats and the instances of those runs, so disjoint ranges can record on
+// different threads
+void VulkanEngine::record_draws(VkCommandBuffer cmd, BindState &binds,
+                                const RenderQueue &queue, size_t first_run,
+                                size_t last_run, GPUInstanceData *instances,
+                                VkDeviceAddress instance_buffer,
+                                EngineStats &draw_stats) {
+    GPUInstancedPushConstants instanced_constants;
+    instanced_constants.view_proj = camera_proj * camera_view;
+    instanced_constants.instance_buffer = instance_buffer;
+
+    const std::vector<RenderQueueEntry> &entries = queue.entries;
+    for (size_t r = first_run; r < last_run; r++) {
+        const RenderQueueRun &run = queue.runs[r];
+
+        const RenderItem &item = render_items[entries[run.begin].item];
+        const GPUMeshBuffers &mesh_buffers = item.mesh->mesh_buffers;
+        const GeoSurface &surface = item.mesh->surfaces[item.surface];
+
+        // packed positions are unorm in the mesh bounds, scale them back
+        // first
+        for (uint32_t i = run.begin; i < run.end; i++) {
+            instances[i].world = render_items[entries[i].item].transform *
+                                 mesh_buffers.dequantize;
+        }
 
-    // invert the y axis
-    projection[1][1] *= -1;
+        uint64_t key = entries[run.begin].key;
+        const IndexBinding &index_binding =
+            queue.index_buffers[sort_key_index_buffer(key)];
+        binds.bind_pipeline(cmd, queue.pipelines[sort_key_pipeline(key)]);
+        binds.bind_descriptor_set(
+            cmd, mesh_instanced_pipeline_layout,
+            queue.descriptor_sets[sort_key_descriptor_set(key)]);
+        binds.bind_index_buffer(cmd, index_binding.buffer, index_binding.type);
+
+        instanced_constants.vertex_buffer = mesh_buffers.vertex_buffer_address;
+        vkCmdPushConstants(cmd, mesh_instanced_pipeline_layout,
+                           VK_SHADER_STAGE_VERTEX_BIT, 0,
+                           sizeof(GPUInstancedPushConstants),
+                           &instanced_constants);
+
+        uint32_t lod = entries[run.begin].lod;
+        const GeoLod &level = surface.lods[lod];
+        uint32_t instance_count = run.end - run.begin;
+        draw_stats.lod_triangles[lod] += level.count / 3 * instance_count;
+        draw_stats.draw_calls++;
+
+        vkCmdDrawIndexed(cmd, level.count, instance_count, level.first_index,
+                         surface.base_vertex, run.begin);
+    }
+}
 
-    push_constants.world_matrix = projection * view;
+void VulkanEngine::draw_geometry(VkCommandBuffer cmd) {
+    stats = {};
 
-    push_constants.vertex_buffer =
-        test_meshes[2]->mesh_buffers.vertex_buffer_address;
+    // every graphics bind of the frame goes through a BindState, which
+    // drops the ones that change nothing and counts the rest
+    bind_state.reset();
 
-    vkCmdPushConstants(cmd, mesh_pipeline_layout, VK_SHADER_STAGE_VERTEX_BIT, 0,
-                       sizeof(GPUDrawPushConstants), &push_constants);
-    vkCmdBindIndexBuffer(cmd, test_meshes[2]->mesh_buffers.index_buffer.buffer,
-                         0, VK_INDEX_TYPE_UINT32);
+    if (gpu_driven) {
+        cull_draws(cmd, false);
+
+        begin_geometry_pass(cmd, true);
+        draw_debug_geometry(cmd, bind_state);
+        draw_indirect(cmd, false);
+        vkCmdEndRendering(cmd);
+
+        // second pass for whatever became visible this frame
+        if (occlusion_culling) {
+            build_depth_pyramid(cmd);
+            cull_draws(cmd, true);
+
+            begin_geometry_pass(cmd, false);
+            draw_indirect(cmd, true);
+            vkCmdEndRendering(cmd);
+        }
+
+        stats.binds = bind_state.stats;
+        return;
+    }
+
+    build_render_queue();
+
+    FrameData &frame = get_current_frame();
+    GPUInstanceData *instances =
+        (GPUInstanceData *)frame.instance_buffer.info.pMappedData;
+    VkDeviceAddress instance_buffer = get_buffer_address(frame.instance_buffer);
 
-    vkCmdDrawIndexed(cmd, test_meshes[2]->surfaces[0].count, 1,
-                     test_meshes[2]->surfaces[0].start_index, 0, 0);
+    size_t run_count = render_queue.runs.size();
+    size_t chunk_count =
+        parallel_recording
+            ? std::clamp<size_t>(run_count / min_runs_per_chunk, 1,
+                                 frame.recording_command_buffers.size())
+            : 1;
 
+    if (chunk_count == 1) {
+        begin_geometry_pass(cmd, true);
+        draw_debug_geometry(cmd, bind_state);
+        record_draws(cmd, bind_state, render_queue, 0, run_count, instances,
+                     instance_buffer, stats);
+        vkCmdEndRendering(cmd);
+
+        stats.binds = bind_state.stats;
+        return;
+    }
+
+    // each chunk records into the secondary of its own slot, the first one
+    // also draws the debug geometry so it stays under the scene
+    EngineStats chunk_stats[max_recording_slots] = {};
+    jobs::parallel_for(chunk_count, [&](size_t c) {
+        VkCommandBuffer secondary = frame.recording_command_buffers[c];
+        VK_CHECK(vkResetCommandPool(device, frame.recording_pools[c], 0));
+        begin_geometry_secondary(secondary);
+
+        BindState binds;
+        if (c == 0) {
+            draw_debug_geometry(secondary, binds);
+        }
+        record_draws(secondary, binds, render_queue,
+                     run_count * c / chunk_count,
+                     run_count * (c + 1) / chunk_count, instances,
+                     instance_buffer, chunk_stats[c]);
+        chunk_stats[c].binds = binds.stats;
+
+        VK_CHECK(vkEndCommandBuffer(secondary));
+    });
+
+    begin_geometry_pass(cmd, true,
+                        VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT);
+    vkCmdExecuteCommands(cmd, (uint32_t)chunk_count,
+                         frame.recording_command_buffers.data());
     vkCmdEndRendering(cmd);
+
+    for (size_t c = 0; c < chunk_count; c++) {
+        for (uint32_t i = 0; i < max_lod_count; i++) {
+            stats.lod_triangles[i] += chunk_stats[c].lod_triangles[i];
+        }
+        stats.draw_calls += chunk_stats[c].draw_calls;
+        stats.binds.pipeline_binds += chunk_stats[c].binds.pipeline_binds;
+        stats.binds.descriptor_set_binds +=
+            chunk_stats[c].binds.descriptor_set_binds;
+        stats.binds.index_buffer_binds +=
+            chunk_stats[c].binds.index_buffer_binds;
+    }
+}
+
+std::vector<RecordBenchmarkResult> VulkanEngine::benchmark_recording() {
+    using clock = std::chrono::steady_clock;
+
+    std::vector<RecordBenchmarkResult> results;
+    if (render_items.empty()) {
+        return results;
+    }
+
+    // every entry gets its own draw id, so nothing merges and the list
+    // looks like a scene without any instancing
+    constexpr uint32_t draw_count = 100000;
+    RenderQueue queue;
+    uint32_t no_set = queue.descriptor_set_id(VK_NULL_HANDLE);
+    for (uint32_t i = 0; i < draw_count; i++) {
+        uint32_t item_index = i % (uint32_t)render_items.size();
+        const RenderItem &item = render_items[item_index];
+        const GPUMeshBuffers &mesh_buffers = item.mesh->mesh_buffers;
+        const GeoSurface &surface = item.mesh->surfaces[item.surface];
+
+        VkPipeline pipeline =
+            mesh_buffers.vertex_format == VertexFormat::Packed
+                ? mesh_instanced_packed_pipeline
+                : mesh_instanced_pipeline;
+        uint64_t key = make_sort_key(
+            queue.pipeline_id(pipeline), no_set,
+            queue.index_buffer_id(mesh_buffers.index_buffer,
+                                  surface.index_type),
+            i, 0.f);
+        queue.push(key, item_index, 0);
+    }
+    queue.find_runs();
+
+    // own pools, the frame ones may still be in flight. nothing recorded
+    // here is ever submitted, so the instances go to scratch memory
+    uint32_t slot_count = std::min(jobs::worker_count() + 1,
+                                   max_recording_slots);
+    std::vector<VkCommandPool> pools(slot_count);
+    std::vector<VkCommandBuffer> command_buffers(slot_count);
+    VkCommandPoolCreateInfo pool_info =
+        vkinit::command_pool_create_info(graphics_queue_family, 0);
+    for (uint32_t i = 0; i < slot_count; i++) {
+        VK_CHECK(vkCreateCommandPool(device, &pool_info, nullptr, &pools[i]));
+
+        VkCommandBufferAllocateInfo cmd_alloc_info =
+            vkinit::command_buffer_allocate_info(
+                pools[i], 1, VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+        VK_CHECK(vkAllocateCommandBuffers(device, &cmd_alloc_info,
+                                          &command_buffers[i]));
+    }
+    std::vector<GPUInstanceData> instances(draw_count);
+
+    for (uint32_t thread_count = 1;; thread_count *= 2) {
+        thread_count = std::min(thread_count, slot_count);
+
+        double best_ms = 1e30;
+        for (int r = 0; r < 3; r++) {
+            auto start = clock::now();
+            jobs::parallel_for(thread_count, [&](size_t c) {
+                VK_CHECK(vkResetCommandPool(device, pools[c], 0));
+                begin_geometry_secondary(command_buffers[c]);
+
+                BindState binds;
+                EngineStats chunk_stats = {};
+                size_t run_count = queue.runs.size();
+                record_draws(command_buffers[c], binds, queue,
+                             run_count * c / thread_count,
+                             run_count * (c + 1) / thread_count,
+                             instances.data(), 0, chunk_stats);
+
+                VK_CHECK(vkEndCommandBuffer(command_buffers[c]));
+            });
+            auto end = clock::now();
+
+            best_ms = std::min(
+                best_ms,
+                std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        results.push_back({thread_count, draw_count, best_ms});
+
+        if (thread_count == slot_count) {
+            break;
+        }
+    }
+
+    for (VkCommandPool pool : pools) {
+        vkDestroyCommandPool(device, pool, nullptr);
+    }
+
+    return results;
 }
 
 AllocatedBuffer VulkanEngine::create_buffer(size_t alloc_size,
@@ -808,6 +1938,14 @@ AllocatedBuffer VulkanEngine::create_buffer(size_t alloc_size,
     buffer_info.size = alloc_size;
     buffer_info.usage = usage;
 
+    // written by the transfer queue and read by graphics
+    uint32_t queue_families[] = {graphics_queue_family, transfer_queue_family};
+    if (transfer_queue_family != graphics_queue_family) {
+        buffer_info.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        buffer_info.queueFamilyIndexCount = 2;
+        buffer_info.pQueueFamilyIndices = queue_families;
+    }
+
     VmaAllocationCreateInfo vma_alloc_info = {};
     vma_alloc_info.usage = memory_usage;
     vma_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
@@ -824,80 +1962,59 @@ void VulkanEngine::destroy_buffer(const AllocatedBuffer &buffer) {
     vmaDestroyBuffer(alloc, buffer.buffer, buffer.allocation);
 }
 
-GPUMeshBuffers VulkanEngine::upload_mesh(std::span<uint32_t> indices,
-                                         std::span<Vertex> vertices) {
-    const size_t vertex_buffer_size = vertices.size() * sizeof(Vertex);
-    const size_t index_buffer_size = indices.size() * sizeof(uint32_t);
-
-    GPUMeshBuffers new_surface;
-
-    // vertex buffer
-    new_surface.vertex_buffer = create_buffer(
-        vertex_buffer_size,
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
-            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY);
-
-    VkBufferDeviceAddressInfo device_address_info{
-        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
-        .buffer = new_surface.vertex_buffer.buffer};
-
-    new_surface.vertex_buffer_address =
-        vkGetBufferDeviceAddress(device, &device_address_info);
-
-    // index buffer
-    new_surface.index_buffer = create_buffer(
-        index_buffer_size,
-        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY);
-
-    // staging buffer
-    AllocatedBuffer staging = create_buffer(
-        vertex_buffer_size + index_buffer_size,
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-
-    void *data = staging.allocation->GetMappedData();
-
-    memcpy(data, vertices.data(), vertex_buffer_size);
-
-    memcpy((char *)data + vertex_buffer_size, indices.data(),
-           index_buffer_size);
-
-    immediate_submit([&](VkCommandBuffer cmd) {
-        VkBufferCopy vertex_copy{0};
-        vertex_copy.dstOffset = 0;
-        vertex_copy.srcOffset = 0;
-        vertex_copy.size = vertex_buffer_size;
-
-        vkCmdCopyBuffer(cmd, staging.buffer, new_surface.vertex_buffer.buffer,
-                        1, &vertex_copy);
-
-        VkBufferCopy index_copy{0};
-        index_copy.dstOffset = 0;
-        index_copy.srcOffset = vertex_buffer_size;
-        index_copy.size = index_buffer_size;
-
-        vkCmdCopyBuffer(cmd, staging.buffer, new_surface.index_buffer.buffer, 1,
-                        &index_copy);
-    });
+GPUMeshBuffers VulkanEngine::upload_mesh(std::span<const uint32_t> indices,
+                                         std::span<const Vertex> vertices) {
+    return upload_mesh(std::as_bytes(indices), std::as_bytes(vertices),
+                       VertexFormat::Full);
+}
 
-    destroy_buffer(staging);
+GPUMeshBuffers VulkanEngine::upload_mesh(std::span<const std::byte> index_data,
+                                         std::span<const std::byte> vertex_data,
+                                         VertexFormat vertex_format,
+                                         std::span<const Meshlet> meshlets) {
+    const size_t vertex_buffer_size = vertex_data.size();
+    const size_t index_buffer_size = index_data.size();
+    const size_t meshlet_buffer_size = meshlets.size_bytes();
+
+    // vertex and index ranges come out of the shared arena buffers
+    GPUMeshBuffers new_surface = mesh_arena.allocate(
+        vertex_buffer_size, vertex_stride(vertex_format), index_buffer_size,
+        meshlet_buffer_size);
+    new_surface.vertex_format = vertex_format;
+    new_surface.dequantize = glm::mat4{1.f};
+
+    VkBuffer vertex_buffer =
+        mesh_arena.blocks[new_surface.arena_block].vertex_buffer.buffer;
+
+    // copies are batched and land asynchronously, draw() waits on the handle
+    uploader.upload_buffer(vertex_buffer, new_surface.vertex_offset,
+                           vertex_data.data(), vertex_buffer_size);
+    if (meshlet_buffer_size > 0) {
+        uploader.upload_buffer(vertex_buffer, new_surface.meshlet_offset,
+                               meshlets.data(), meshlet_buffer_size);
+    }
+    new_surface.upload =
+        uploader.upload_buffer(new_surface.index_buffer,
+                               new_surface.index_offset, index_data.data(),
+                               index_buffer_size);
 
     return new_surface;
 }
 
-void VulkanEngine::init_mesh_pipeline() {
+void VulkanEngine::init_mesh_pipeline(PipelineBatch &batch) {
     VkShaderModule triangle_frag_shader;
-    if (!vkutil::loader_shader_module("shaders/colored_triangle.frag.spv",
-                                      device, &triangle_frag_shader)) {
+    if (!pipeline_registry.shader_module(
+            device, "shaders/colored_triangle.frag.spv",
+            &triangle_frag_shader)) {
         fmt::println("Error when building the triangle fragment shader module");
     } else {
         fmt::println("Triangle fragment shader successfully loaded");
     }
 
     VkShaderModule triangle_vertex_shader;
-    if (!vkutil::loader_shader_module("shaders/colored_triangle_mesh.vert.spv",
-                                      device, &triangle_vertex_shader)) {
+    if (!pipeline_registry.shader_module(
+            device, "shaders/colored_triangle_mesh.vert.spv",
+            &triangle_vertex_shader)) {
         fmt::println("Error when building the triangle vertex shader module");
     } else {
         fmt::println("Triangle vertex shader successfully loaded");
@@ -924,23 +2041,373 @@ void VulkanEngine::init_mesh_pipeline() {
     pipeline_builder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
     pipeline_builder.set_multisampling_none();
     pipeline_builder.disable_blending();
-    pipeline_builder.disable_depthtest();
+    // reversed depth, 1 at the near plane
+    pipeline_builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
 
     pipeline_builder.set_color_attachment_format(draw_img.img_format);
-    pipeline_builder.set_depth_format(VK_FORMAT_UNDEFINED);
+    pipeline_builder.set_depth_format(depth_img.img_format);
+
+    batch.add(pipeline_builder.describe(), &mesh_pipeline);
 
-    mesh_pipeline = pipeline_builder.build_pipeline(device);
+    // instanced variants share the fragment stage and state, they only
+    // differ in the vertex fetch
+    VkShaderModule instanced_vertex_shader;
+    if (!pipeline_registry.shader_module(
+            device, "shaders/mesh_instanced.vert.spv",
+            &instanced_vertex_shader)) {
+        fmt::println("Error when building the instanced vertex shader module");
+    }
 
-    vkDestroyShaderModule(device, triangle_frag_shader, nullptr);
-    vkDestroyShaderModule(device, triangle_vertex_shader, nullptr);
+    VkShaderModule packed_vertex_shader;
+    if (!pipeline_registry.shader_module(
+            device, "shaders/mesh_instanced_packed.vert.spv",
+            &packed_vertex_shader)) {
+        fmt::println("Error when building the packed vertex shader module");
+    }
+
+    VkPushConstantRange instanced_range{};
+    instanced_range.offset = 0;
+    instanced_range.size = sizeof(GPUInstancedPushConstants);
+    instanced_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkPipelineLayoutCreateInfo instanced_layout_info =
+        vkinit::pipeline_layout_create_info();
+    instanced_layout_info.pPushConstantRanges = &instanced_range;
+    instanced_layout_info.pushConstantRangeCount = 1;
+
+    VK_CHECK(vkCreatePipelineLayout(device, &instanced_layout_info, nullptr,
+                                    &mesh_instanced_pipeline_layout));
+
+    pipeline_builder.pipeline_layout = mesh_instanced_pipeline_layout;
+    pipeline_builder.set_shaders(instanced_vertex_shader, triangle_frag_shader);
+    batch.add(pipeline_builder.describe(), &mesh_instanced_pipeline);
+
+    pipeline_builder.set_shaders(packed_vertex_shader, triangle_frag_shader);
+    batch.add(pipeline_builder.describe(), &mesh_instanced_packed_pipeline);
 
     main_deletion_queue.push_func([&]() {
         vkDestroyPipelineLayout(device, mesh_pipeline_layout, nullptr);
-        vkDestroyPipeline(device, mesh_pipeline, nullptr);
+        vkDestroyPipelineLayout(device, mesh_instanced_pipeline_layout,
+                                nullptr);
     });
 }
 
+void VulkanEngine::init_indirect_pipelines(PipelineBatch &batch) {
+    VkShaderModule cull_shader;
+    if (!pipeline_registry.shader_module(device, "shaders/cull.comp.spv",
+                                         &cull_shader)) {
+        fmt::println("Error when building the cull shader");
+    }
+
+    VkPushConstantRange cull_range{};
+    cull_range.offset = 0;
+    cull_range.size = sizeof(GPUCullPushConstants);
+    cull_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo cull_layout_info =
+        vkinit::pipeline_layout_create_info();
+    cull_layout_info.pSetLayouts = &cull_descriptor_layout;
+    cull_layout_info.setLayoutCount = 1;
+    cull_layout_info.pPushConstantRanges = &cull_range;
+    cull_layout_info.pushConstantRangeCount = 1;
+
+    VK_CHECK(vkCreatePipelineLayout(device, &cull_layout_info, nullptr,
+                                    &cull_pipeline_layout));
+
+    VkPipelineShaderStageCreateInfo stage_info = {};
+    stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    stage_info.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    stage_info.module = cull_shader;
+    stage_info.pName = "main";
+
+    batch.add(ComputePipelineDesc{stage_info, cull_pipeline_layout},
+              &cull_pipeline);
+
+    VkShaderModule reduce_shader;
+    if (!pipeline_registry.shader_module(
+            device, "shaders/depth_reduce.comp.spv", &reduce_shader)) {
+        fmt::println("Error when building the depth reduce shader");
+    }
+
+    VkPushConstantRange reduce_range{};
+    reduce_range.offset = 0;
+    reduce_range.size = sizeof(glm::vec4);
+    reduce_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+    VkPipelineLayoutCreateInfo reduce_layout_info =
+        vkinit::pipeline_layout_create_info();
+    reduce_layout_info.pSetLayouts = &depth_reduce_descriptor_layout;
+    reduce_layout_info.setLayoutCount = 1;
+    reduce_layout_info.pPushConstantRanges = &reduce_range;
+    reduce_layout_info.pushConstantRangeCount = 1;
+
+    VK_CHECK(vkCreatePipelineLayout(device, &reduce_layout_info, nullptr,
+                                    &depth_reduce_pipeline_layout));
+
+    stage_info.module = reduce_shader;
+    batch.add(ComputePipelineDesc{stage_info, depth_reduce_pipeline_layout},
+              &depth_reduce_pipeline);
+
+    VkShaderModule frag_shader;
+    if (!pipeline_registry.shader_module(
+            device, "shaders/colored_triangle.frag.spv", &frag_shader)) {
+        fmt::println("Error when building the triangle fragment shader module");
+    }
+
+    VkShaderModule vertex_shader;
+    if (!pipeline_registry.shader_module(
+            device, "shaders/mesh_indirect.vert.spv", &vertex_shader)) {
+        fmt::println("Error when building the indirect vertex shader module");
+    }
+
+    VkPushConstantRange draw_range{};
+    draw_range.offset = 0;
+    draw_range.size = sizeof(GPUIndirectPushConstants);
+    draw_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkPipelineLayoutCreateInfo draw_layout_info =
+        vkinit::pipeline_layout_create_info();
+    draw_layout_info.pPushConstantRanges = &draw_range;
+    draw_layout_info.pushConstantRangeCount = 1;
+
+    VK_CHECK(vkCreatePipelineLayout(device, &draw_layout_info, nullptr,
+                                    &indirect_pipeline_layout));
+
+    PipelineBuilder pipeline_builder;
+    pipeline_builder.pipeline_layout = indirect_pipeline_layout;
+    pipeline_builder.set_shaders(vertex_shader, frag_shader);
+    pipeline_builder.set_input_topology(VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST);
+    pipeline_builder.set_polygon_mode(VK_POLYGON_MODE_FILL);
+    pipeline_builder.set_cull_mode(VK_CULL_MODE_NONE, VK_FRONT_FACE_CLOCKWISE);
+    pipeline_builder.set_multisampling_none();
+    pipeline_builder.disable_blending();
+    // reversed depth, 1 at the near plane
+    pipeline_builder.enable_depthtest(true, VK_COMPARE_OP_GREATER_OR_EQUAL);
+
+    pipeline_builder.set_color_attachment_format(draw_img.img_format);
+    pipeline_builder.set_depth_format(depth_img.img_format);
+
+    batch.add(pipeline_builder.describe(), &indirect_pipeline);
+
+    main_deletion_queue.push_func([&]() {
+        vkDestroyPipelineLayout(device, cull_pipeline_layout, nullptr);
+        vkDestroyPipelineLayout(device, depth_reduce_pipeline_layout, nullptr);
+        vkDestroyPipelineLayout(device, indirect_pipeline_layout, nullptr);
+    });
+}
+
+void VulkanEngine::upload_draw_objects() {
+    std::vector<GPUDrawObject> &objects = draw_objects;
+    objects.clear();
+    objects.reserve(render_items.size());
+    item_objects.resize(render_items.size());
+    draw_buckets.clear();
+
+    // group surfaces by what the draw call binds, each group gets one
+    // contiguous range of commands
+    std::vector<std::vector<uint32_t>> bucket_items;
+    for (uint32_t i = 0; i < render_items.size(); i++) {
+        const RenderItem &item = render_items[i];
+        const GPUMeshBuffers &buffers = item.mesh->mesh_buffers;
+        const GeoSurface &surface = item.mesh->surfaces[item.surface];
+
+        uint32_t b = 0;
+        for (; b < draw_buckets.size(); b++) {
+            if (draw_buckets[b].index_buffer == buffers.index_buffer &&
+                draw_buckets[b].index_type == surface.index_type) {
+                break;
+            }
+        }
+        if (b == draw_buckets.size()) {
+            draw_buckets.push_back({buffers.index_buffer, surface.index_type,
+                                    buffers.vertex_buffer_address, 0, 0});
+            bucket_items.emplace_back();
+        }
+        bucket_items[b].push_back(i);
+    }
+
+    uint32_t command_base = 0;
+    for (uint32_t b = 0; b < draw_buckets.size(); b++) {
+        DrawBucket &bucket = draw_buckets[b];
+        bucket.command_base = command_base;
+        bucket.max_draw_count = (uint32_t)bucket_items[b].size();
+        command_base += bucket.max_draw_count;
+
+        for (uint32_t i : bucket_items[b]) {
+            const RenderItem &item = render_items[i];
+            const GPUMeshBuffers &buffers = item.mesh->mesh_buffers;
+            const GeoSurface &surface = item.mesh->surfaces[item.surface];
+
+            GPUDrawObject object = {};
+            for (uint32_t l = 0; l < surface.lod_count; l++) {
+                object.lod_first_index[l] = surface.lods[l].first_index;
+                object.lod_index_count[l] = surface.lods[l].count;
+            }
+            object.base_vertex = surface.base_vertex;
+            object.lod_count = surface.lod_count;
+            object.bucket = b;
+            object.command_base = bucket.command_base;
+            object.vertex_format = buffers.vertex_format;
+
+            item_objects[i] = (uint32_t)objects.size();
+            objects.push_back(object);
+            update_draw_object(i);
+        }
+    }
+
+    draw_object_count = (uint32_t)objects.size();
+    if (draw_object_count == 0) {
+        return;
+    }
+
+    draw_object_buffer = create_buffer(
+        objects.size() * sizeof(GPUDrawObject),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+    uploader.upload_buffer(draw_object_buffer.buffer, 0, objects.data(),
+                           objects.size() * sizeof(GPUDrawObject));
+
+    draw_command_buffer = create_buffer(
+        2 * objects.size() * sizeof(VkDrawIndexedIndirectCommand),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    draw_count_buffer = create_buffer(
+        2 * draw_buckets.size() * sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+            VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT |
+            VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    // nothing counts as seen before the first frame, so the late pass
+    // draws everything that survives the first pyramid
+    std::vector<uint32_t> visibility(objects.size(), 0);
+    draw_visibility_buffer = create_buffer(
+        visibility.size() * sizeof(uint32_t),
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+    uploader.upload_buffer(draw_visibility_buffer.buffer, 0, visibility.data(),
+                           visibility.size() * sizeof(uint32_t));
+
+    main_deletion_queue.push_func([&]() {
+        destroy_buffer(draw_object_buffer);
+        destroy_buffer(draw_command_buffer);
+        destroy_buffer(draw_count_buffer);
+        destroy_buffer(draw_visibility_buffer);
+    });
+}
+
+// the parts of a draw object that follow the transform of its item
+void VulkanEngine::update_draw_object(uint32_t item_index) {
+    const RenderItem &item = render_items[item_index];
+    const GeoSurface &surface = item.mesh->surfaces[item.surface];
+    GPUDrawObject &object = draw_objects[item_objects[item_index]];
+
+    object.world = item.transform * item.mesh->mesh_buffers.dequantize;
+    object.sphere = glm::vec4(render_bounds.center_x[item_index],
+                              render_bounds.center_y[item_index],
+                              render_bounds.center_z[item_index],
+                              render_bounds.radius[item_index]);
+
+    float scale = max_axis_scale(item.transform);
+    for (uint32_t l = 0; l < surface.lod_count; l++) {
+        object.lod_error[l] = surface.lods[l].error * scale;
+    }
+}
+
+void VulkanEngine::update_scene(VkCommandBuffer cmd) {
+    scene_changed.clear();
+    scene.update(scene_changed);
+    if (scene_changed.empty()) {
+        return;
+    }
+
+    std::vector<uint32_t> objects;
+    for (uint32_t node : scene_changed) {
+        for (uint32_t i = node_items[node]; i < node_items[node + 1]; i++) {
+            RenderItem &item = render_items[i];
+            item.transform = scene.world[node];
+            render_bounds.set(
+                i, transform_bounds(item.mesh->surfaces[item.surface].bounds,
+                                    item.transform));
+
+            if (draw_object_count > 0) {
+                update_draw_object(i);
+                objects.push_back(item_objects[i]);
+            }
+        }
+    }
+    if (objects.empty()) {
+        return;
+    }
+
+    // bucketing scatters the objects of a node, stage them in buffer order
+    // so neighbours merge into one copy region
+    std::sort(objects.begin(), objects.end());
+
+    GPUDrawObject *staged =
+        (GPUDrawObject *)get_current_frame().object_updates.info.pMappedData;
+    std::vector<VkBufferCopy> regions;
+    for (size_t i = 0; i < objects.size(); i++) {
+        staged[i] = draw_objects[objects[i]];
+
+        if (i > 0 && objects[i] == objects[i - 1] + 1) {
+            regions.back().size += sizeof(GPUDrawObject);
+        } else {
+            regions.push_back({i * sizeof(GPUDrawObject),
+                               objects[i] * sizeof(GPUDrawObject),
+                               sizeof(GPUDrawObject)});
+        }
+    }
+
+    // last frame's culling and vertex reads have to finish before the
+    // objects are overwritten
+    VkMemoryBarrier2 read_barrier = {.sType =
+                                         VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    read_barrier.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                                VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+    read_barrier.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+    read_barrier.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    read_barrier.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+
+    VkDependencyInfo dependency = {.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO};
+    dependency.memoryBarrierCount = 1;
+    dependency.pMemoryBarriers = &read_barrier;
+    vkCmdPipelineBarrier2(cmd, &dependency);
+
+    vkCmdCopyBuffer(cmd, get_current_frame().object_updates.buffer,
+                    draw_object_buffer.buffer, (uint32_t)regions.size(),
+                    regions.data());
+
+    VkMemoryBarrier2 write_barrier = {.sType =
+                                          VK_STRUCTURE_TYPE_MEMORY_BARRIER_2};
+    write_barrier.srcStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT;
+    write_barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+    write_barrier.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT |
+                                 VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+    write_barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+    dependency.pMemoryBarriers = &write_barrier;
+    vkCmdPipelineBarrier2(cmd, &dependency);
+}
+
+VkDeviceAddress VulkanEngine::get_buffer_address(const AllocatedBuffer &buffer) {
+    VkBufferDeviceAddressInfo device_address_info{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = buffer.buffer};
+
+    return vkGetBufferDeviceAddress(device, &device_address_info);
+}
+
 void VulkanEngine::init_default_data() {
+    mesh_arena.init(this, 64 * 1024 * 1024, 32 * 1024 * 1024);
+
+    main_deletion_queue.push_func([&]() { mesh_arena.destroy(); });
+
     std::array<Vertex, 4> rect_vertices;
 
     rect_vertices[0].position = {0.5, -0.5, 0};
@@ -965,5 +2432,73 @@ void VulkanEngine::init_default_data() {
 
     rectangle = upload_mesh(rect_indices, rect_vertices);
 
-    test_meshes = load_gltf_meshes(this, "assets/basicmesh.glb").value();
+    LoadedAsset asset = load_asset(this, "assets/basicmesh.glb").value();
+    scene_meshes = std::move(asset.meshes);
+
+    // the scene is a grid of copies of the test asset stretching away from
+    // the camera, each cell a root node over the asset hierarchy
+    for (int cell = 0; cell < scene_grid_size * scene_grid_size; cell++) {
+        uint32_t root = scene.add_node(
+            grid_cell_transform(cell, scene_grid_size), no_parent_node);
+        scene.add_nodes(asset.nodes, root, 0);
+        scene_roots.push_back(root);
+    }
+    scene.update(scene_changed);
+    scene_changed.clear();
+
+    std::vector<uint32_t> mesh_surface_ids;
+    uint32_t surface_count = 0;
+    for (const std::shared_ptr<MeshAsset> &mesh : scene_meshes) {
+        mesh_surface_ids.push_back(surface_count);
+        surface_count += (uint32_t)mesh->surfaces.size();
+    }
+
+    // one render item per surface of every node with a mesh
+    node_items.resize(scene.size() + 1);
+    for (uint32_t n = 0; n < scene.size(); n++) {
+        node_items[n] = (uint32_t)render_items.size();
+        if (scene.mesh[n] < 0) {
+            continue;
+        }
+
+        MeshAsset *mesh = scene_meshes[scene.mesh[n]].get();
+        for (uint32_t s = 0; s < mesh->surfaces.size(); s++) {
+            render_items.push_back({mesh, s, n,
+                                    mesh_surface_ids[scene.mesh[n]] + s,
+                                    scene.world[n]});
+            render_bounds.add(
+                transform_bounds(mesh->surfaces[s].bounds, scene.world[n]));
+        }
+    }
+    node_items[scene.size()] = (uint32_t)render_items.size();
+
+    upload_draw_objects();
+
+    for (int i = 0; i < FRAME_OVERLAP; i++) {
+        frames[i].cull_params = create_buffer(
+            sizeof(GPUCullParams),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+        // every item could be visible at once
+        frames[i].instance_buffer = create_buffer(
+            std::max<size_t>(render_items.size(), 1) * sizeof(GPUInstanceData),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT |
+                VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+            VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+        // every object could change at once
+        frames[i].object_updates = create_buffer(
+            std::max<size_t>(draw_objects.size(), 1) * sizeof(GPUDrawObject),
+            VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+
+        main_deletion_queue.push_func([=, this]() {
+            destroy_buffer(frames[i].cull_params);
+            destroy_buffer(frames[i].instance_buffer);
+            destroy_buffer(frames[i].object_updates);
+        });
+    }
+
+    uploader.submit();
 }
@@ -1,8 +1,17 @@
 #pragma once
 
+#include "vk_bounds.h"
+#include "vk_cull.h"
 #include "vk_descriptors.h"
+#include "vk_jobs.h"
 #include "vk_loader.h"
+#include "vk_mesh_arena.h"
+#include "vk_pipelines.h"
+#include "vk_render_queue.h"
+#include "vk_scene.h"
+#include "vk_shader_watch.h"
 #include "vk_types.h"
+#include "vk_upload.h"
 
 
 struct DeletionQueue {
@@ -28,24 +37,99 @@ struct ComputePushConstants {
     glm::vec4 data4;
 };
 
+// a bool specialization constant of a compute effect
+struct ComputeEffectToggle {
+    const char *name;
+    bool enabled;
+};
+
+// time of one workgroup size from the last auto tune
+struct WorkgroupTiming {
+    VkExtent2D size;
+    float milliseconds;
+};
+
 struct ComputeEffect {
     const char *name;
+    // the pipeline of the current variant
     VkPipeline pipeline;
     VkPipelineLayout layout;
     ComputePushConstants data;
+
+    const char *shader_path;
+    // specialization constants 0 and 1, what the dispatch is divided by
+    VkExtent2D workgroup_size{16, 16};
+    // constants from 2 on, in order
+    std::vector<ComputeEffectToggle> toggles;
+    std::vector<WorkgroupTiming> timings;
 };
 
 struct FrameData {
     VkCommandPool command_pool;
     VkCommandBuffer main_command_buffer;
+    // one pool and secondary per recording slot, so chunks of the geometry
+    // pass are recorded on the job workers without sharing a pool
+    std::vector<VkCommandPool> recording_pools;
+    std::vector<VkCommandBuffer> recording_command_buffers;
     VkSemaphore swapchain_semaphore;
     VkSemaphore render_semaphore;
     VkFence render_fence;
     DeletionQueue deletion_queue;
+    // GPUCullParams, persistently mapped
+    AllocatedBuffer cull_params;
+    // GPUInstanceData for every render item, persistently mapped
+    AllocatedBuffer instance_buffer;
+    // GPUDrawObjects changed this frame, copied into the draw object
+    // buffer, persistently mapped
+    AllocatedBuffer object_updates;
 };
 
 constexpr unsigned int FRAME_OVERLAP = 2;
 
+// secondaries the geometry pass can be split into per frame
+constexpr uint32_t max_recording_slots = 32;
+
+// enough mips for a 32k wide pyramid
+constexpr uint32_t max_depth_pyramid_levels = 16;
+
+// draws that share an index buffer, index type and vertex buffer, issued
+// as one indirect count call
+struct DrawBucket {
+    VkBuffer index_buffer;
+    VkIndexType index_type;
+    VkDeviceAddress vertex_buffer_address;
+    uint32_t command_base;
+    uint32_t max_draw_count;
+};
+
+// one placement of a surface of a mesh
+struct RenderItem {
+    MeshAsset *mesh;
+    uint32_t surface;
+    // scene node the transform comes from
+    uint32_t node;
+    // dense over the surfaces of every scene mesh, for sort keys
+    uint32_t surface_id;
+    glm::mat4 transform;
+};
+
+// best time to record draw_count single draws split across thread_count
+// secondaries
+struct RecordBenchmarkResult {
+    uint32_t thread_count;
+    uint32_t draw_count;
+    double milliseconds;
+};
+
+// counters of the last recorded frame, shown in the debug ui
+struct EngineStats {
+    uint32_t lod_triangles[max_lod_count];
+    uint32_t visible_items;
+    uint32_t culled_items;
+    uint32_t draw_calls;
+    BindStats binds;
+};
+
 class VulkanEngine {
   public:
     bool is_init{false};
@@ -71,26 +155,118 @@ class VulkanEngine {
     };
     VkQueue graphics_queue;
     uint32_t graphics_queue_family;
+    // dedicated transfer queue when the device has one, graphics otherwise
+    VkQueue transfer_queue;
+    uint32_t transfer_queue_family;
     VmaAllocator alloc;
     AllocactedImg draw_img;
     AllocactedImg depth_img;
+    // min reduced mip chain of the depth image, power of two below the
+    // draw image in size
+    AllocactedImg depth_pyramid;
+    uint32_t depth_pyramid_width;
+    uint32_t depth_pyramid_height;
+    uint32_t depth_pyramid_levels;
+    VkImageView depth_pyramid_mips[max_depth_pyramid_levels];
+    VkSampler depth_reduce_sampler;
     VkExtent2D draw_extent;
     DescriptorAllocator global_descriptor_allocator;
     VkDescriptorSet draw_img_descriptors;
     VkDescriptorSetLayout draw_img_descriptor_layout;
+    // level i is written from level i - 1, level 0 from the depth image
+    VkDescriptorSet depth_reduce_descriptors[max_depth_pyramid_levels];
+    VkDescriptorSetLayout depth_reduce_descriptor_layout;
+    VkDescriptorSet cull_descriptors;
+    VkDescriptorSetLayout cull_descriptor_layout;
     //    VkPipeline gradient_pipeline;
     VkPipelineLayout gradient_pipeline_layout;
     VkFence imm_fence;
     VkCommandBuffer imm_command_buffer;
     VkCommandPool imm_command_pool;
+    UploadBatcher uploader;
+    MeshArena mesh_arena;
     std::vector<ComputeEffect> background_effects;
     int current_background_effect{0};
+    VkPipelineCache pipeline_cache;
+    // whether pipeline_cache started from data on disk, and how long
+    // init_pipelines took with it
+    bool pipeline_cache_warm{false};
+    float pipeline_build_ms{0.f};
+    // owns every pipeline and shader module the engine builds
+    PipelineRegistry pipeline_registry;
+    // changes in the shaders directory, rebuilt between frames
+    ShaderWatcher shader_watcher;
+    uint32_t shader_reloads{0};
     VkPipelineLayout triangle_pipeline_layout;
     VkPipeline triangle_pipeline;
     VkPipelineLayout mesh_pipeline_layout;
     VkPipeline mesh_pipeline;
+    // per instance transforms come from the frame's instance buffer
+    VkPipelineLayout mesh_instanced_pipeline_layout;
+    VkPipeline mesh_instanced_pipeline;
+    VkPipeline mesh_instanced_packed_pipeline;
     GPUMeshBuffers rectangle;
-    std::vector<std::shared_ptr<MeshAsset>> test_meshes;
+    // screen space error in pixels a simplified level may show
+    float lod_pixel_error{1.f};
+    EngineStats stats;
+    std::vector<std::shared_ptr<MeshAsset>> scene_meshes;
+    // copies of the test asset along each side of the scene grid, each
+    // under its own root node
+    int scene_grid_size{5};
+    SceneGraph scene;
+    std::vector<uint32_t> scene_roots;
+    // degrees around y, applied to every root
+    float scene_rotation{0.f};
+    // render items of node n are [node_items[n], node_items[n + 1])
+    std::vector<uint32_t> node_items;
+    std::vector<uint32_t> scene_changed;
+    // render_bounds row i holds the world bounds of render_items[i]
+    std::vector<RenderItem> render_items;
+    BoundsTable render_bounds;
+    // indices into render_items that passed culling this frame
+    std::vector<uint32_t> visible_items;
+    // visible items keyed by state, off draws them in culling order
+    bool sort_draws{true};
+    // records large draw lists into secondaries on the job workers
+    bool parallel_recording{true};
+    RenderQueue render_queue;
+    BindState bind_state;
+    std::vector<RecordBenchmarkResult> record_benchmark;
+    std::vector<jobs::BenchmarkResult> job_benchmark;
+    std::vector<CullBenchmarkResult> cull_benchmark;
+
+    // culls and selects levels for every render item in cull.comp, then
+    // draws each bucket with a single indirect count call
+    bool gpu_driven{true};
+    // draws what was visible last frame, builds the depth pyramid from it
+    // and then draws whatever the pyramid does not hide
+    bool occlusion_culling{true};
+    VkPipelineLayout cull_pipeline_layout;
+    VkPipeline cull_pipeline;
+    VkPipelineLayout depth_reduce_pipeline_layout;
+    VkPipeline depth_reduce_pipeline;
+    VkPipelineLayout indirect_pipeline_layout;
+    VkPipeline indirect_pipeline;
+    // GPUDrawObject per render item, VkDrawIndexedIndirectCommand per
+    // render item and one draw count per bucket, commands and counts twice
+    // over for the early and the late pass
+    AllocatedBuffer draw_object_buffer;
+    AllocatedBuffer draw_command_buffer;
+    AllocatedBuffer draw_count_buffer;
+    AllocatedBuffer draw_visibility_buffer;
+    std::vector<DrawBucket> draw_buckets;
+    uint32_t draw_object_count{0};
+    // cpu copy of the draw object buffer, item_objects[i] is the object of
+    // render_items[i]
+    std::vector<GPUDrawObject> draw_objects;
+    std::vector<uint32_t> item_objects;
+
+    glm::mat4 camera_view;
+    glm::mat4 camera_proj;
+    // projected size in pixels of one unit at distance one
+    float camera_pixel_scale;
+    // depth is reversed, the near plane maps to 1
+    float camera_znear;
 
     static VulkanEngine &Get();
     void init();
@@ -98,7 +274,16 @@ class VulkanEngine {
     void draw();
     void run();
     void immediate_submit(std::function<void(VkCommandBuffer cmd)> &&function);
-    GPUMeshBuffers upload_mesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
+    GPUMeshBuffers upload_mesh(std::span<const uint32_t> indices,
+                               std::span<const Vertex> vertices);
+    GPUMeshBuffers upload_mesh(std::span<const std::byte> index_data,
+                               std::span<const std::byte> vertex_data,
+                               VertexFormat vertex_format,
+                               std::span<const Meshlet> meshlets = {});
+    AllocatedBuffer create_buffer(size_t alloc_size, VkBufferUsageFlags usage,
+                                  VmaMemoryUsage memory_usage);
+    void destroy_buffer(const AllocatedBuffer &buffer);
+    VkDeviceAddress get_buffer_address(const AllocatedBuffer &buffer);
 
   private:
     void init_vulkan();
@@ -107,18 +292,42 @@ class VulkanEngine {
     void init_sync_structures();
     void init_descriptors();
     void init_pipelines();
-    void init_background_pipelines();
+    void init_pipeline_cache();
+    void init_background_pipelines(PipelineBatch &batch);
     void init_imgui();
-    void init_triangle_pipeline();
-    void init_mesh_pipeline();
+    void init_triangle_pipeline(PipelineBatch &batch);
+    void init_mesh_pipeline(PipelineBatch &batch);
+    void init_indirect_pipelines(PipelineBatch &batch);
+    void reload_shaders();
+    ComputePipelineDesc describe_effect(const ComputeEffect &effect,
+                                        VkExtent2D workgroup_size);
+    void build_effect_variant(ComputeEffect &effect);
+    void tune_effect(ComputeEffect &effect);
+    void upload_draw_objects();
+    void update_draw_object(uint32_t item);
+    void update_scene(VkCommandBuffer cmd);
+    void init_depth_pyramid();
+    void update_camera();
+    void cull_draws(VkCommandBuffer cmd, bool late);
+    void draw_indirect(VkCommandBuffer cmd, bool late);
+    void build_depth_pyramid(VkCommandBuffer cmd);
+    void begin_geometry_pass(VkCommandBuffer cmd, bool clear_depth,
+                             VkRenderingFlags flags = 0);
+    void begin_geometry_secondary(VkCommandBuffer cmd);
+    void set_draw_viewport(VkCommandBuffer cmd);
+    void draw_debug_geometry(VkCommandBuffer cmd, BindState &binds);
+    void build_render_queue();
+    void record_draws(VkCommandBuffer cmd, BindState &binds,
+                      const RenderQueue &queue, size_t first_run,
+                      size_t last_run, GPUInstanceData *instances,
+                      VkDeviceAddress instance_buffer,
+                      EngineStats &draw_stats);
+    std::vector<RecordBenchmarkResult> benchmark_recording();
     void resize_swapchain();
     void create_swapchain(uint32_t width, uint32_t height);
     void destroy_swapchain();
     void draw_background(VkCommandBuffer cmd);
     void draw_imgui(VkCommandBuffer cmd, VkImageView targetImageView);
     void draw_geometry(VkCommandBuffer cmd);
-    AllocatedBuffer create_buffer(size_t alloc_size, VkBufferUsageFlags usage,
-                                  VmaMemoryUsage memory_usage);
-    void destroy_buffer(const AllocatedBuffer &buffer);
     void init_default_data();
 };
@@ -0,0 +1,404 @@
+#include "vk_import.h"
+#include "vk_jobs.h"
+#include "vk_mesh_cache.h"
+#include "vk_meshopt.h"
+
+#include <cstring>
+
+#include <fastgltf/glm_element_traits.hpp>
+#include <fastgltf/parser.hpp>
+#include <fastgltf/tools.hpp>
+
+#define GLM_ENABLE_EXPERIMENTAL 1
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/quaternion.hpp>
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include <tiny_obj_loader.h>
+
+// only reads from the asset, safe to call for several meshes at once
+static MeshData decode_gltf_mesh(fastgltf::Asset &gltf,
+                                 fastgltf::Mesh &mesh) {
+    MeshData data;
+    data.name = mesh.name;
+
+    std::vector<uint32_t> &indices = data.indices;
+    std::vector<Vertex> &vertices = data.vertices;
+
+    for (auto &&p : mesh.primitives) {
+        // nothing to draw without positions
+        auto positions = p.findAttribute("POSITION");
+        if (positions == p.attributes.end()) {
+            continue;
+        }
+
+        size_t initial_vtx = vertices.size();
+
+        // load vertex positions
+        fastgltf::Accessor &pos_accessor = gltf.accessors[positions->second];
+        vertices.resize(vertices.size() + pos_accessor.count);
+
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(
+            gltf, pos_accessor, [&](glm::vec3 v, size_t index) {
+                Vertex new_vtx;
+                new_vtx.position = v;
+                new_vtx.normal = {1, 0, 0};
+                new_vtx.color = glm::vec4{1.f};
+                new_vtx.uv_x = 0;
+                new_vtx.uv_y = 0;
+                vertices[initial_vtx + index] = new_vtx;
+            });
+
+        GeoSurface new_surface = {};
+        new_surface.lods[0].start_index = (uint32_t)indices.size();
+
+        // load indexes. unindexed primitives get one index per vertex, like
+        // the OBJ path, and welding merges the duplicates later
+        if (p.indicesAccessor.has_value()) {
+            fastgltf::Accessor &index_accessor =
+                gltf.accessors[p.indicesAccessor.value()];
+            indices.reserve(indices.size() + index_accessor.count);
+
+            fastgltf::iterateAccessor<std::uint32_t>(
+                gltf, index_accessor, [&](std::uint32_t idx) {
+                    indices.push_back(idx + initial_vtx);
+                });
+        } else {
+            indices.reserve(indices.size() + pos_accessor.count);
+            for (size_t i = 0; i < pos_accessor.count; i++) {
+                indices.push_back((uint32_t)(initial_vtx + i));
+            }
+        }
+
+        new_surface.lods[0].count =
+            (uint32_t)indices.size() - new_surface.lods[0].start_index;
+
+        // load vertex normals
+        auto normals = p.findAttribute("NORMAL");
+        if (normals != p.attributes.end()) {
+            fastgltf::iterateAccessorWithIndex<glm::vec3>(
+                gltf, gltf.accessors[(*normals).second],
+                [&](glm::vec3 v, size_t index) {
+                    vertices[initial_vtx + index].normal = v;
+                });
+        }
+
+        // UVs
+        auto uv = p.findAttribute("TEXCOORD_0");
+        if (uv != p.attributes.end()) {
+            fastgltf::iterateAccessorWithIndex<glm::vec2>(
+                gltf, gltf.accessors[(*uv).second],
+                [&](glm::vec2 v, size_t index) {
+                    vertices[initial_vtx + index].uv_x = v.x;
+                    vertices[initial_vtx + index].uv_y = v.y;
+                });
+        }
+        data.surfaces.push_back(new_surface);
+    }
+
+    // display vertex normals
+    constexpr bool override_colors = true;
+    if (override_colors) {
+        for (Vertex &vtx : vertices) {
+            vtx.color = glm::vec4(vtx.normal, 1.f);
+        }
+    }
+
+    return data;
+}
+
+static glm::mat4 gltf_node_transform(const fastgltf::Node &node) {
+    glm::mat4 transform{1.f};
+    std::visit(
+        fastgltf::visitor{
+            [&](const fastgltf::Node::TransformMatrix &matrix) {
+                memcpy(&transform, matrix.data(), sizeof(matrix));
+            },
+            [&](const fastgltf::Node::TRS &trs) {
+                glm::vec3 translation(trs.translation[0], trs.translation[1],
+                                      trs.translation[2]);
+                glm::quat rotation(trs.rotation[3], trs.rotation[0],
+                                   trs.rotation[1], trs.rotation[2]);
+                glm::vec3 scale(trs.scale[0], trs.scale[1], trs.scale[2]);
+
+                transform = glm::translate(glm::mat4{1.f}, translation) *
+                            glm::toMat4(rotation) *
+                            glm::scale(glm::mat4{1.f}, scale);
+            }},
+        node.transform);
+
+    return transform;
+}
+
+// nodes of the default scene in depth first order, so every parent comes
+// before its children and every subtree is contiguous
+static std::vector<SceneNode> import_gltf_nodes(const fastgltf::Asset &gltf) {
+    std::vector<size_t> roots;
+    if (!gltf.scenes.empty()) {
+        size_t scene =
+            gltf.defaultScene.has_value() ? gltf.defaultScene.value() : 0;
+        roots.assign(gltf.scenes[scene].nodeIndices.begin(),
+                     gltf.scenes[scene].nodeIndices.end());
+    } else {
+        // without scenes every node nobody points at is a root
+        std::vector<bool> is_child(gltf.nodes.size(), false);
+        for (const fastgltf::Node &node : gltf.nodes) {
+            for (size_t child : node.children) {
+                if (child < is_child.size()) {
+                    is_child[child] = true;
+                }
+            }
+        }
+        for (size_t i = 0; i < gltf.nodes.size(); i++) {
+            if (!is_child[i]) {
+                roots.push_back(i);
+            }
+        }
+    }
+
+    std::vector<SceneNode> nodes;
+    std::vector<bool> visited(gltf.nodes.size(), false);
+
+    // gltf node and the index of its parent in nodes, children are pushed
+    // in reverse so they come out in file order
+    std::vector<std::pair<size_t, uint32_t>> stack;
+    for (auto it = roots.rbegin(); it != roots.rend(); it++) {
+        stack.push_back({*it, no_parent_node});
+    }
+
+    while (!stack.empty()) {
+        auto [index, parent] = stack.back();
+        stack.pop_back();
+
+        // broken files may share a node between parents or form a cycle
+        if (index >= gltf.nodes.size() || visited[index]) {
+            continue;
+        }
+        visited[index] = true;
+
+        const fastgltf::Node &gltf_node = gltf.nodes[index];
+
+        SceneNode node = {};
+        node.local = gltf_node_transform(gltf_node);
+        node.parent = parent;
+        node.mesh = gltf_node.meshIndex.has_value() &&
+                            gltf_node.meshIndex.value() < gltf.meshes.size()
+                        ? (int32_t)gltf_node.meshIndex.value()
+                        : -1;
+
+        uint32_t node_index = (uint32_t)nodes.size();
+        nodes.push_back(node);
+
+        for (size_t c = gltf_node.children.size(); c > 0; c--) {
+            stack.push_back({gltf_node.children[c - 1], node_index});
+        }
+    }
+
+    return nodes;
+}
+
+std::optional<ImportedAsset>
+import_gltf(const std::filesystem::path &file_path) {
+    fastgltf::GltfDataBuffer data;
+    data.loadFromFile(file_path);
+
+    constexpr auto gltf_options = fastgltf::Options::LoadGLBBuffers |
+                                  fastgltf::Options::LoadExternalBuffers;
+
+    fastgltf::Asset gltf;
+    fastgltf::Parser parser{};
+
+    auto load =
+        file_path.extension() == ".gltf"
+            ? parser.loadGLTF(&data, file_path.parent_path(), gltf_options)
+            : parser.loadBinaryGLTF(&data, file_path.parent_path(),
+                                    gltf_options);
+    if (load) {
+        gltf = std::move(load.get());
+    } else {
+        fmt::print("Failed to load glTF: {}\n",
+                   fastgltf::to_underlying(load.error()));
+        return {};
+    }
+
+    ImportedAsset asset;
+
+    // decode every mesh into its own buffers in parallel
+    asset.meshes.resize(gltf.meshes.size());
+
+    jobs::parallel_for(gltf.meshes.size(), [&](size_t i) {
+        asset.meshes[i] = decode_gltf_mesh(gltf, gltf.meshes[i]);
+    });
+
+    asset.nodes = import_gltf_nodes(gltf);
+
+    return asset;
+}
+
+uint64_t hash_asset_source(const std::filesystem::path &file_path) {
+    uint64_t hash = hash_file(file_path);
+
+    std::filesystem::path ext = file_path.extension();
+    if (ext != ".gltf" && ext != ".glb") {
+        return hash;
+    }
+
+    // only the json, the buffers are hashed as files instead of loaded
+    fastgltf::GltfDataBuffer data;
+    data.loadFromFile(file_path);
+
+    fastgltf::Parser parser{};
+    auto load =
+        ext == ".gltf"
+            ? parser.loadGLTF(&data, file_path.parent_path(),
+                              fastgltf::Options::None)
+            : parser.loadBinaryGLTF(&data, file_path.parent_path(),
+                                    fastgltf::Options::None);
+    if (!load) {
+        return hash;
+    }
+
+    // data uris sit in the json and are covered by its hash already
+    constexpr uint64_t prime = 0x100000001b3;
+    for (const fastgltf::Buffer &buffer : load->buffers) {
+        const auto *uri = std::get_if<fastgltf::sources::URI>(&buffer.data);
+        if (uri != nullptr && uri->uri.isLocalPath()) {
+            std::filesystem::path buffer_path =
+                file_path.parent_path() / uri->uri.fspath();
+            hash = (hash ^ hash_file(buffer_path)) * prime;
+        }
+    }
+
+    return hash;
+}
+
+std::optional<ImportedAsset>
+import_obj(const std::filesystem::path &file_path) {
+    tinyobj::ObjReaderConfig config;
+    config.triangulate = true;
+    config.vertex_color = false;
+
+    tinyobj::ObjReader reader;
+    if (!reader.ParseFromFile(file_path.string(), config)) {
+        fmt::print("Failed to load OBJ: {}\n", reader.Error());
+        return {};
+    }
+
+    const tinyobj::attrib_t &attrib = reader.GetAttrib();
+    const std::vector<tinyobj::shape_t> &shapes = reader.GetShapes();
+
+    // obj has no shared vertices, every corner becomes its own vertex and
+    // welding merges them again
+    ImportedAsset asset;
+    asset.meshes.resize(shapes.size());
+
+    jobs::parallel_for(shapes.size(), [&](size_t i) {
+        const tinyobj::shape_t &shape = shapes[i];
+        MeshData &data = asset.meshes[i];
+        data.name = shape.name;
+
+        data.vertices.reserve(shape.mesh.indices.size());
+        data.indices.reserve(shape.mesh.indices.size());
+
+        for (const tinyobj::index_t &idx : shape.mesh.indices) {
+            Vertex new_vtx;
+            new_vtx.position = {attrib.vertices[3 * idx.vertex_index + 0],
+                                attrib.vertices[3 * idx.vertex_index + 1],
+                                attrib.vertices[3 * idx.vertex_index + 2]};
+            new_vtx.normal = {1, 0, 0};
+            new_vtx.uv_x = 0;
+            new_vtx.uv_y = 0;
+
+            if (idx.normal_index >= 0) {
+                new_vtx.normal = {attrib.normals[3 * idx.normal_index + 0],
+                                  attrib.normals[3 * idx.normal_index + 1],
+                                  attrib.normals[3 * idx.normal_index + 2]};
+            }
+
+            if (idx.texcoord_index >= 0) {
+                new_vtx.uv_x = attrib.texcoords[2 * idx.texcoord_index + 0];
+                new_vtx.uv_y = attrib.texcoords[2 * idx.texcoord_index + 1];
+            }
+
+            // display vertex normals, same as the gltf path
+            new_vtx.color = glm::vec4(new_vtx.normal, 1.f);
+
+            data.indices.push_back((uint32_t)data.vertices.size());
+            data.vertices.push_back(new_vtx);
+        }
+
+        GeoSurface new_surface = {};
+        new_surface.lods[0].start_index = 0;
+        new_surface.lods[0].count = (uint32_t)data.indices.size();
+        data.surfaces.push_back(new_surface);
+    });
+
+    return asset;
+}
+
+std::optional<ImportedAsset>
+import_asset(const std::filesystem::path &file_path,
+             const MeshOptOptions &options) {
+    std::filesystem::path ext = file_path.extension();
+
+    std::optional<ImportedAsset> asset;
+    if (ext == ".glb" || ext == ".gltf") {
+        asset = import_gltf(file_path);
+    } else if (ext == ".obj") {
+        asset = import_obj(file_path);
+    } else {
+        fmt::print("Unsupported mesh format: {}\n", file_path.string());
+        return {};
+    }
+
+    if (asset) {
+        std::vector<MeshData> &meshes = asset->meshes;
+        std::vector<MeshOptStats> stats(meshes.size());
+        jobs::parallel_for(meshes.size(), [&](size_t i) {
+            stats[i] = optimize_mesh(meshes[i], options);
+        });
+
+        MeshOptStats total = {};
+        for (const MeshOptStats &s : stats) {
+            total.triangle_count += s.triangle_count;
+            total.lod_triangle_count += s.lod_triangle_count;
+            total.meshlet_count += s.meshlet_count;
+            total.transforms_before += s.transforms_before;
+            total.transforms_after += s.transforms_after;
+            total.vertex_bytes_before += s.vertex_bytes_before;
+            total.vertex_bytes_after += s.vertex_bytes_after;
+            total.index_bytes_before += s.index_bytes_before;
+            total.index_bytes_after += s.index_bytes_after;
+        }
+
+        if (total.triangle_count > 0) {
+            fmt::print("{}: ACMR {:.3f} -> {:.3f} over {} triangles\n",
+                       file_path.filename().string(),
+                       (float)total.transforms_before / total.triangle_count,
+                       (float)total.transforms_after / total.triangle_count,
+                       total.triangle_count);
+            fmt::print("{}: {} triangles in simplified levels, {} meshlets\n",
+                       file_path.filename().string(), total.lod_triangle_count,
+                       total.meshlet_count);
+            fmt::print("{}: vertex data {} -> {} bytes\n",
+                       file_path.filename().string(), total.vertex_bytes_before,
+                       total.vertex_bytes_after);
+            fmt::print("{}: index data {} -> {} bytes\n",
+                       file_path.filename().string(), total.index_bytes_before,
+                       total.index_bytes_after);
+        }
+
+        // without a hierarchy every mesh sits once at the origin
+        if (asset->nodes.empty()) {
+            for (size_t i = 0; i < meshes.size(); i++) {
+                SceneNode node = {};
+                node.local = glm::mat4{1.f};
+                node.parent = no_parent_node;
+                node.mesh = (int32_t)i;
+                asset->nodes.push_back(node);
+            }
+        }
+    }
+
+    return asset;
+}
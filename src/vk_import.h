@@ -0,0 +1,22 @@
+#pragma once
+
+#include "vk_loader.h"
+#include "vk_meshopt.h"
+
+// source asset decoding, shared by the engine and graphi_cook. nothing in
+// here touches a vulkan device
+
+// meshes and the node hierarchy of the default scene
+std::optional<ImportedAsset> import_gltf(const std::filesystem::path &file_path);
+// meshes only, obj has no hierarchy
+std::optional<ImportedAsset> import_obj(const std::filesystem::path &file_path);
+
+// hash of the source file folded with the hash of every external file it
+// pulls geometry from, so editing a .bin referenced by a .gltf changes it
+uint64_t hash_asset_source(const std::filesystem::path &file_path);
+
+// picks the importer from the file extension and runs the optimization
+// stages of vk_meshopt on every mesh
+std::optional<ImportedAsset>
+import_asset(const std::filesystem::path &file_path,
+             const MeshOptOptions &options = {});
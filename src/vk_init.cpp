@@ -15,13 +15,14 @@ vkinit::command_pool_create_info(uint32_t queue_family_index,
 }
 
 VkCommandBufferAllocateInfo
-vkinit::command_buffer_allocate_info(VkCommandPool pool, uint32_t count) {
+vkinit::command_buffer_allocate_info(VkCommandPool pool, uint32_t count,
+                                     VkCommandBufferLevel level) {
     VkCommandBufferAllocateInfo info = {};
     info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     info.pNext = nullptr;
     info.commandPool = pool;
     info.commandBufferCount = count;
-    info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    info.level = level;
 
     return info;
 }
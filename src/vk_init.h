@@ -6,8 +6,9 @@ namespace vkinit {
 VkCommandPoolCreateInfo
 command_pool_create_info(uint32_t queue_family_index,
                          VkCommandPoolCreateFlags flags);
-VkCommandBufferAllocateInfo command_buffer_allocate_info(VkCommandPool pool,
-                                                         uint32_t count);
+VkCommandBufferAllocateInfo command_buffer_allocate_info(
+    VkCommandPool pool, uint32_t count,
+    VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
 VkCommandBufferBeginInfo
 command_buffer_begin_info(VkCommandBufferUsageFlags flags);
 VkFenceCreateInfo fence_create_info(VkFenceCreateFlags flags);
@@ -0,0 +1,344 @@
+#include "vk_jobs.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <thread>
+
+namespace {
+struct TaskQueue {
+    std::mutex mutex;
+    std::deque<jobs::Task> tasks;
+};
+
+// one cache line per thread slot so counting does not bounce lines
+struct alignas(64) SlotStats {
+    std::atomic<uint64_t> tasks_run{0};
+    std::atomic<uint64_t> steals{0};
+    std::atomic<uint64_t> steal_attempts{0};
+};
+
+struct Scheduler {
+    std::vector<std::thread> workers;
+    // one per worker, the owner pushes and pops at the back and thieves
+    // take from the front. the last one is shared by every other thread
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    std::vector<std::unique_ptr<SlotStats>> stats;
+    // tasks sitting in any queue
+    std::atomic<uint32_t> queued{0};
+    std::atomic<uint32_t> sleeping{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool quit{false};
+};
+
+Scheduler scheduler;
+
+constexpr uint32_t no_worker = ~0u;
+thread_local uint32_t worker_index = no_worker;
+
+uint32_t shared_queue() { return (uint32_t)scheduler.workers.size(); }
+
+uint32_t own_queue() {
+    return worker_index == no_worker ? shared_queue() : worker_index;
+}
+
+void ensure_queues(size_t count) {
+    while (scheduler.queues.size() < count) {
+        scheduler.queues.push_back(std::make_unique<TaskQueue>());
+        scheduler.stats.push_back(std::make_unique<SlotStats>());
+    }
+}
+
+void push(jobs::Task task) {
+    ensure_queues(1);
+
+    TaskQueue &queue = *scheduler.queues[own_queue()];
+    {
+        // counted first so queued never drops below what the deques hold
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        scheduler.queued.fetch_add(1);
+        queue.tasks.push_back(std::move(task));
+    }
+
+    // a worker counts itself as sleeping before it checks queued, so either
+    // it sees the task or we see it and wake it
+    if (scheduler.sleeping.load() > 0) {
+        { std::lock_guard<std::mutex> lock(scheduler.sleep_mutex); }
+        scheduler.wake.notify_one();
+    }
+}
+
+bool try_pop(uint32_t self, jobs::Task &task) {
+    if (scheduler.queued.load() == 0) {
+        return false;
+    }
+
+    // own deque newest first, what was just pushed is still in cache
+    {
+        TaskQueue &queue = *scheduler.queues[self];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+            scheduler.queued.fetch_sub(1);
+            return true;
+        }
+    }
+
+    // everyone else's oldest first, those tend to be the biggest pieces
+    SlotStats &stats = *scheduler.stats[self];
+    uint32_t queue_count = (uint32_t)scheduler.queues.size();
+    for (uint32_t i = 1; i < queue_count; i++) {
+        TaskQueue &queue = *scheduler.queues[(self + i) % queue_count];
+        stats.steal_attempts.fetch_add(1, std::memory_order_relaxed);
+
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            scheduler.queued.fetch_sub(1);
+            stats.steals.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void finish(jobs::Counter &counter) {
+    counter.finishing.fetch_add(1);
+
+    if (counter.pending.fetch_sub(1) == 1) {
+        std::vector<jobs::Task> ready;
+        {
+            std::lock_guard<std::mutex> lock(counter.mutex);
+            ready.swap(counter.continuations);
+        }
+        for (jobs::Task &task : ready) {
+            push(std::move(task));
+        }
+    }
+
+    // the last touch, a waiter may free the counter right after
+    counter.finishing.fetch_sub(1);
+}
+
+void execute(uint32_t self, jobs::Task &task) {
+    task.func();
+    scheduler.stats[self]->tasks_run.fetch_add(1, std::memory_order_relaxed);
+
+    if (task.counter != nullptr) {
+        finish(*task.counter);
+    }
+}
+
+void worker_main(uint32_t index) {
+    worker_index = index;
+
+    while (true) {
+        jobs::Task task;
+        if (try_pop(index, task)) {
+            execute(index, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(scheduler.sleep_mutex);
+        scheduler.sleeping.fetch_add(1);
+        scheduler.wake.wait(lock, [] {
+            return scheduler.quit || scheduler.queued.load() > 0;
+        });
+        scheduler.sleeping.fetch_sub(1);
+
+        if (scheduler.quit && scheduler.queued.load() == 0) {
+            return;
+        }
+    }
+}
+} // namespace
+
+void jobs::init(uint32_t worker_count) {
+    if (!scheduler.workers.empty()) {
+        return;
+    }
+
+    if (worker_count == 0) {
+        uint32_t hw = std::thread::hardware_concurrency();
+        worker_count = hw > 1 ? hw - 1 : 1;
+    }
+
+    // the queues have to exist before any worker looks at them
+    scheduler.queues.clear();
+    scheduler.stats.clear();
+    ensure_queues(worker_count + 1);
+
+    scheduler.quit = false;
+    for (uint32_t i = 0; i < worker_count; i++) {
+        scheduler.workers.emplace_back(worker_main, i);
+    }
+}
+
+void jobs::shutdown() {
+    {
+        std::lock_guard<std::mutex> lock(scheduler.sleep_mutex);
+        scheduler.quit = true;
+    }
+    scheduler.wake.notify_all();
+
+    // workers drain the queues before they leave
+    for (std::thread &t : scheduler.workers) {
+        t.join();
+    }
+
+    scheduler.workers.clear();
+}
+
+uint32_t jobs::worker_count() { return (uint32_t)scheduler.workers.size(); }
+
+void jobs::run(std::function<void()> func, Counter *counter) {
+    if (counter != nullptr) {
+        counter->pending.fetch_add(1);
+    }
+
+    push({std::move(func), counter});
+}
+
+void jobs::run_after(Counter &after, std::function<void()> func,
+                     Counter *counter) {
+    if (counter != nullptr) {
+        counter->pending.fetch_add(1);
+    }
+
+    Task task = {std::move(func), counter};
+    {
+        // finish() takes the continuations under the same lock after the
+        // count hit zero, so a task added here is never left behind
+        std::lock_guard<std::mutex> lock(after.mutex);
+        if (after.pending.load() > 0) {
+            after.continuations.push_back(std::move(task));
+            return;
+        }
+    }
+
+    push(std::move(task));
+}
+
+void jobs::wait(Counter &counter) {
+    ensure_queues(1);
+
+    // help instead of blocking, the tasks counted may sit in our own deque
+    uint32_t self = own_queue();
+    while (counter.pending.load() > 0 || counter.finishing.load() > 0) {
+        Task task;
+        if (try_pop(self, task)) {
+            execute(self, task);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void jobs::parallel_for(size_t count,
+                        const std::function<void(size_t)> &func) {
+    if (count == 0) {
+        return;
+    }
+
+    // no workers or nothing to share, run inline
+    if (scheduler.workers.empty() || count == 1) {
+        for (size_t i = 0; i < count; i++) {
+            func(i);
+        }
+        return;
+    }
+
+    // iterations are claimed one at a time, helpers that start late find
+    // nothing left and return. wait() covers the helpers, so the loop can
+    // live on the stack
+    std::atomic<size_t> next{0};
+    auto drain = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < count) {
+            func(i);
+        }
+    };
+
+    Counter helpers;
+    size_t helper_count = std::min<size_t>(scheduler.workers.size(), count - 1);
+    for (size_t i = 0; i < helper_count; i++) {
+        run(drain, &helpers);
+    }
+
+    drain();
+    wait(helpers);
+}
+
+jobs::Stats jobs::stats() {
+    Stats total = {};
+    for (const std::unique_ptr<SlotStats> &slot : scheduler.stats) {
+        total.tasks_run += slot->tasks_run.load();
+        total.steals += slot->steals.load();
+        total.steal_attempts += slot->steal_attempts.load();
+    }
+    return total;
+}
+
+void jobs::reset_stats() {
+    for (const std::unique_ptr<SlotStats> &slot : scheduler.stats) {
+        slot->tasks_run = 0;
+        slot->steals = 0;
+        slot->steal_attempts = 0;
+    }
+}
+
+static void spawn_tree(uint32_t depth, jobs::Counter *counter) {
+    if (depth == 0) {
+        return;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        jobs::run([=]() { spawn_tree(depth - 1, counter); }, counter);
+    }
+}
+
+std::vector<jobs::BenchmarkResult> jobs::benchmark() {
+    using clock = std::chrono::steady_clock;
+
+    std::vector<BenchmarkResult> results;
+
+    auto measure = [&](const char *name, const std::function<void()> &body) {
+        reset_stats();
+
+        auto start = clock::now();
+        body();
+        auto end = clock::now();
+
+        Stats totals = stats();
+        double ms = std::chrono::duration<double, std::milli>(end - start)
+                        .count();
+        results.push_back({name, totals.tasks_run, totals.steals,
+                           totals.tasks_run / std::max(ms, 1e-6)});
+    };
+
+    // everything lands in the shared deque, so every task is taken from a
+    // queue that is not the taker's own
+    measure("flat", [] {
+        Counter counter;
+        for (uint32_t i = 0; i < 1 << 20; i++) {
+            run([] {}, &counter);
+        }
+        wait(counter);
+    });
+
+    // children go to the deque of whoever runs the parent, workers only
+    // leave their own deque to steal when it runs dry
+    measure("tree", [] {
+        Counter counter;
+        spawn_tree(19, &counter);
+        wait(counter);
+    });
+
+    return results;
+}
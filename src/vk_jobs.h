@@ -0,0 +1,71 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace jobs {
+// starts the worker threads, 0 picks one per hardware thread minus the caller
+void init(uint32_t worker_count = 0);
+void shutdown();
+
+uint32_t worker_count();
+
+struct Task {
+    std::function<void()> func;
+    struct Counter *counter;
+};
+
+// number of unfinished tasks started against it. tasks queued with
+// run_after wait for it to reach zero. has to outlive every task it counts
+struct Counter {
+    Counter() = default;
+    Counter(const Counter &) = delete;
+    Counter &operator=(const Counter &) = delete;
+
+    std::atomic<uint32_t> pending{0};
+    // tasks between their last decrement and being done with the counter,
+    // a waiter must not let go of the counter before they are
+    std::atomic<uint32_t> finishing{0};
+    std::mutex mutex;
+    std::vector<Task> continuations;
+};
+
+// queues func on the deque of the calling worker, or on the shared deque
+// from any other thread. counter, when given, counts it until it returns
+void run(std::function<void()> func, Counter *counter = nullptr);
+// queues func once after reaches zero
+void run_after(Counter &after, std::function<void()> func,
+               Counter *counter = nullptr);
+// runs queued tasks on the calling thread until counter reaches zero
+void wait(Counter &counter);
+
+// runs func(i) for every i in [0, count) on the workers and the calling
+// thread, returns once all iterations have finished
+void parallel_for(size_t count, const std::function<void(size_t)> &func);
+
+// totals over every thread since the last reset_stats
+struct Stats {
+    uint64_t tasks_run;
+    // tasks taken from another thread's deque
+    uint64_t steals;
+    uint64_t steal_attempts;
+};
+
+Stats stats();
+void reset_stats();
+
+struct BenchmarkResult {
+    const char *name;
+    uint64_t task_count;
+    uint64_t steals;
+    double tasks_per_ms;
+};
+
+// tiny tasks spawned from the caller, and a binary tree of tasks that each
+// spawn their children so idle workers have to steal
+std::vector<BenchmarkResult> benchmark();
+}; // namespace jobs
@@ -2,125 +2,104 @@
 #include <iostream>
 #include <stb_image.h>
 
+#include "vk_bounds.h"
 #include "vk_engine.h"
+#include "vk_import.h"
 #include "vk_init.h"
+#include "vk_mesh_cache.h"
 #include "vk_types.h"
 
 #define GLM_ENABLE_EXPERIMENTAL 1
+#include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 
-#include <fastgltf/glm_element_traits.hpp>
-#include <fastgltf/parser.hpp>
-#include <fastgltf/tools.hpp>
+static std::shared_ptr<MeshAsset> upload_mesh_asset(VulkanEngine *engine,
+                                                    const MeshView &mesh) {
+    MeshAsset new_mesh;
+    new_mesh.name = mesh.name;
+    new_mesh.surfaces.assign(mesh.surfaces.begin(), mesh.surfaces.end());
+    new_mesh.meshlets.assign(mesh.meshlets.begin(), mesh.meshlets.end());
+    new_mesh.mesh_buffers =
+        engine->upload_mesh(mesh.index_data, mesh.vertex_data,
+                            mesh.vertex_format, mesh.meshlets);
+
+    if (mesh.vertex_format == VertexFormat::Packed) {
+        new_mesh.mesh_buffers.dequantize = glm::scale(
+            glm::translate(glm::mat4{1.f}, mesh.quant_offset), mesh.quant_scale);
+    }
 
-std::optional<std::vector<std::shared_ptr<MeshAsset>>>
-load_gltf_meshes(VulkanEngine *engine, std::filesystem::path file_path) {
-    fmt::print("Loading GLTF: {}\n", file_path.string());
+    if (!new_mesh.surfaces.empty()) {
+        new_mesh.bounds = new_mesh.surfaces[0].bounds;
+        for (const GeoSurface &surface : new_mesh.surfaces) {
+            new_mesh.bounds = merge_bounds(new_mesh.bounds, surface.bounds);
+        }
+    }
 
-    fastgltf::GltfDataBuffer data;
-    data.loadFromFile(file_path);
+    // the arena keeps index ranges 4 byte aligned, so the offset is a whole
+    // number of elements for either index type
+    const GPUMeshBuffers &buffers = new_mesh.mesh_buffers;
+    for (GeoSurface &surface : new_mesh.surfaces) {
+        uint32_t mesh_first_index =
+            (uint32_t)(buffers.index_offset / index_size(surface.index_type));
+        for (uint32_t i = 0; i < surface.lod_count; i++) {
+            surface.lods[i].first_index =
+                mesh_first_index + surface.lods[i].start_index;
+        }
+        surface.base_vertex =
+            buffers.base_vertex + (int32_t)surface.vertex_offset;
+    }
 
-    constexpr auto gltf_options = fastgltf::Options::LoadGLBBuffers |
-                                  fastgltf::Options::LoadExternalBuffers;
+    return std::make_shared<MeshAsset>(std::move(new_mesh));
+}
 
-    fastgltf::Asset gltf;
-    fastgltf::Parser parser{};
+std::optional<LoadedAsset> load_asset(VulkanEngine *engine,
+                                      std::filesystem::path file_path) {
+    fmt::print("Loading asset: {}\n", file_path.string());
 
-    auto load =
-        parser.loadBinaryGLTF(&data, file_path.parent_path(), gltf_options);
-    fmt::print("past\n");
-    if (load) {
-        gltf = std::move(load.get());
-    } else {
-        fmt::print("Failed to load glTF: {}\n",
-                   fastgltf::to_underlying(load.error()));
-        return {};
-    }
+    uint64_t source_hash = hash_asset_source(file_path);
+    std::filesystem::path cache_path = mesh_cache_path(file_path);
+    // a cache cooked with other options is rebuilt with these
+    MeshOptOptions options;
+
+    LoadedAsset asset;
+    std::vector<std::shared_ptr<MeshAsset>> &meshes = asset.meshes;
 
-    std::vector<std::shared_ptr<MeshAsset>> meshes;
-
-    std::vector<uint32_t> indices;
-    std::vector<Vertex> vertices;
-    for (fastgltf::Mesh &mesh : gltf.meshes) {
-        MeshAsset new_mesh;
-
-        new_mesh.name = mesh.name;
-
-        indices.clear();
-        vertices.clear();
-
-        for (auto &&p : mesh.primitives) {
-            GeoSurface new_surface;
-            new_surface.start_index = (uint32_t)indices.size();
-            new_surface.count =
-                (uint32_t)gltf.accessors[p.indicesAccessor.value()].count;
-
-            size_t initial_vtx = vertices.size();
-
-            // load indexes
-            {
-                fastgltf::Accessor &index_accessor =
-                    gltf.accessors[p.indicesAccessor.value()];
-                indices.reserve(indices.size() + index_accessor.count);
-
-                fastgltf::iterateAccessor<std::uint32_t>(
-                    gltf, index_accessor, [&](std::uint32_t idx) {
-                        indices.push_back(idx + initial_vtx);
-                    });
-            }
-
-            // load vertex positions
-            {
-                fastgltf::Accessor &pos_accessor =
-                    gltf.accessors[p.findAttribute("POSITION")->second];
-                vertices.resize(vertices.size() + pos_accessor.count);
-
-                fastgltf::iterateAccessorWithIndex<glm::vec3>(
-                    gltf, pos_accessor, [&](glm::vec3 v, size_t index) {
-                        Vertex new_vtx;
-                        new_vtx.position = v;
-                        new_vtx.normal = {1, 0, 0};
-                        new_vtx.color = glm::vec4{1.f};
-                        new_vtx.uv_x = 0;
-                        new_vtx.uv_y = 0;
-                        vertices[initial_vtx + index] = new_vtx;
-                    });
-            }
-
-            // UVs
-            auto normals = p.findAttribute("NORMAL");
-            if (normals != p.attributes.end()) {
-                fastgltf::iterateAccessorWithIndex<glm::vec3>(
-                    gltf, gltf.accessors[(*normals).second],
-                    [&](glm::vec3 v, size_t index) {
-                        vertices[initial_vtx + index].normal = v;
-                    });
-            }
-
-            // load vertex colors
-            auto uv = p.findAttribute("TEXCOORD_0");
-            if (uv != p.attributes.end()) {
-                fastgltf::iterateAccessorWithIndex<glm::vec2>(
-                    gltf, gltf.accessors[(*uv).second],
-                    [&](glm::vec2 v, size_t index) {
-                        vertices[initial_vtx + index].uv_x = v.x;
-                        vertices[initial_vtx + index].uv_y = v.y;
-                    });
-            }
-            new_mesh.surfaces.push_back(new_surface);
+    // a baked cache of the same source skips parsing and decoding entirely,
+    // the mapped data is copied straight into staging
+    MeshCache cache;
+    if (cache.open(cache_path, source_hash, options)) {
+        fmt::print("Using baked cache: {}\n", cache_path.string());
+
+        meshes.reserve(cache.mesh_count());
+        for (size_t i = 0; i < cache.mesh_count(); i++) {
+            meshes.push_back(upload_mesh_asset(engine, cache.mesh(i)));
+        }
+        asset.nodes.assign(cache.nodes().begin(), cache.nodes().end());
+    } else {
+        std::optional<ImportedAsset> decoded =
+            import_asset(file_path, options);
+        if (!decoded) {
+            return {};
         }
 
-        // display vertex normals
-        constexpr bool override_colors = true;
-        if (override_colors) {
-            for (Vertex &vtx : vertices) {
-                vtx.color = glm::vec4(vtx.normal, 1.f);
-            }
+        if (!write_mesh_cache(cache_path, source_hash, options,
+                              decoded->meshes, decoded->nodes)) {
+            fmt::print("Failed to write mesh cache: {}\n",
+                       cache_path.string());
         }
-        new_mesh.mesh_buffers = engine->upload_mesh(indices, vertices);
 
-        meshes.emplace_back(std::make_shared<MeshAsset>(std::move(new_mesh)));
+        // upload once everything is decoded
+        meshes.reserve(decoded->meshes.size());
+        for (const MeshData &mesh_data : decoded->meshes) {
+            meshes.push_back(upload_mesh_asset(engine, mesh_data.view()));
+        }
+        asset.nodes = std::move(decoded->nodes);
     }
 
-    return meshes;
+    // the copies finish in the background, draw() waits on their handles
+    engine->uploader.submit();
+    fmt::print("Uploaded {} meshes in {} submits\n", meshes.size(),
+               engine->uploader.submit_count);
+
+    return asset;
 }
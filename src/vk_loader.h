@@ -1,21 +1,133 @@
 #pragma once
 
+#include "vk_scene.h"
 #include "vk_types.h"
 #include <unordered_map>
 #include <filesystem>
 
-struct GeoSurface {
+// one index range of a surface, every level shares the surface vertices
+struct GeoLod {
+    // counted in elements of the surface index_type from the start of the
+    // mesh indices
     uint32_t start_index;
     uint32_t count;
+    // how far the level may deviate from full detail, in mesh units
+    float error;
+    // absolute offset into the mesh arena, set once the mesh is uploaded
+    uint32_t first_index;
+};
+
+struct GeoSurface {
+    // lods[0] is full detail, each following level has about half the
+    // triangles of the one before
+    GeoLod lods[max_lod_count];
+    uint32_t lod_count{1};
+
+    // full detail bounds in mesh units
+    Bounds bounds;
+
+    // range in the mesh meshlets, empty when the mesh was imported without
+    uint32_t meshlet_offset{0};
+    uint32_t meshlet_count{0};
+
+    // surfaces with 16 bit indices store them relative to this vertex
+    uint32_t vertex_offset{0};
+    VkIndexType index_type{VK_INDEX_TYPE_UINT32};
+    // absolute offset into the mesh arena, set once the mesh is uploaded
+    int32_t base_vertex;
+};
+
+// read only view of one mesh ready for upload, either decoded or mapped from
+// a baked cache
+struct MeshView {
+    std::string_view name;
+    std::span<const GeoSurface> surfaces;
+    // mix of 16 and 32 bit index ranges, see GeoSurface::index_type
+    std::span<const std::byte> index_data;
+
+    VertexFormat vertex_format;
+    // Vertex or PackedVertex array depending on vertex_format
+    std::span<const std::byte> vertex_data;
+    glm::vec3 quant_offset;
+    glm::vec3 quant_scale;
+
+    std::span<const Meshlet> meshlets;
+};
+
+// cpu side result of decoding one mesh, indices are relative to the mesh
+struct MeshData {
+    std::string name;
+
+    std::vector<GeoSurface> surfaces;
+    // indices holds 32 bit indices until pack_indices moves every surface
+    // into packed_indices at its final index type
+    std::vector<uint32_t> indices;
+    std::vector<std::byte> packed_indices;
+
+    // vertices holds the data until quantization picks the packed format,
+    // which moves it into packed_vertices
+    VertexFormat vertex_format{VertexFormat::Full};
+    std::vector<Vertex> vertices;
+    std::vector<PackedVertex> packed_vertices;
+    // packed positions decode as quant_offset + position * quant_scale
+    glm::vec3 quant_offset{0.f};
+    glm::vec3 quant_scale{1.f};
+
+    std::vector<Meshlet> meshlets;
+
+    size_t vertex_count() const {
+        return vertex_format == VertexFormat::Packed ? packed_vertices.size()
+                                                     : vertices.size();
+    }
+
+    std::span<const std::byte> vertex_data() const {
+        if (vertex_format == VertexFormat::Packed) {
+            return std::as_bytes(std::span(packed_vertices));
+        }
+        return std::as_bytes(std::span(vertices));
+    }
+
+    std::span<const std::byte> index_data() const {
+        if (!packed_indices.empty()) {
+            return packed_indices;
+        }
+        return std::as_bytes(std::span(indices));
+    }
+
+    MeshView view() const {
+        return MeshView{name,          surfaces,      index_data(),
+                        vertex_format, vertex_data(), quant_offset,
+                        quant_scale,   meshlets};
+    }
+};
+
+// decoded contents of one source file
+struct ImportedAsset {
+    std::vector<MeshData> meshes;
+    // placement of the meshes, parents first. sources without a hierarchy
+    // get one root per mesh
+    std::vector<SceneNode> nodes;
 };
 
 struct MeshAsset {
     std::string name;
 
     std::vector<GeoSurface> surfaces;
+    // union of the surface bounds, in mesh units
+    Bounds bounds;
+    // cpu copy of what mesh_buffers holds at meshlet_offset
+    std::vector<Meshlet> meshlets;
     GPUMeshBuffers mesh_buffers;
 };
 
+// uploaded meshes of one source file and the nodes that place them, node
+// mesh indices point into meshes
+struct LoadedAsset {
+    std::vector<std::shared_ptr<MeshAsset>> meshes;
+    std::vector<SceneNode> nodes;
+};
+
 class VulkanEngine;
 
-std::optional<std::vector<std::shared_ptr<MeshAsset>>> load_gltf_meshes(VulkanEngine *engine, std::filesystem::path file_path);
+std::optional<LoadedAsset> load_asset(VulkanEngine *engine,
+                                      std::filesystem::path file_path);
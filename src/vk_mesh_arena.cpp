@@ -0,0 +1,182 @@
+#include "vk_mesh_arena.h"
+#include "vk_engine.h"
+
+#include <algorithm>
+
+// std430 vec4 alignment of the Meshlet array
+constexpr VkDeviceSize meshlet_alignment = 16;
+
+void RangeAllocator::init(VkDeviceSize size) {
+    free_ranges.clear();
+    free_ranges[0] = size;
+}
+
+std::optional<VkDeviceSize> RangeAllocator::allocate(VkDeviceSize size,
+                                                     VkDeviceSize alignment) {
+    // empty ranges take no space, free() ignores them the same way
+    if (size == 0) {
+        return 0;
+    }
+
+    for (auto it = free_ranges.begin(); it != free_ranges.end(); it++) {
+        VkDeviceSize range_offset = it->first;
+        VkDeviceSize range_end = it->first + it->second;
+
+        VkDeviceSize offset =
+            (range_offset + alignment - 1) / alignment * alignment;
+        if (offset + size > range_end) {
+            continue;
+        }
+
+        free_ranges.erase(it);
+
+        // keep the padding in front and the tail behind as free ranges
+        if (offset > range_offset) {
+            free_ranges[range_offset] = offset - range_offset;
+        }
+        if (offset + size < range_end) {
+            free_ranges[offset + size] = range_end - (offset + size);
+        }
+
+        return offset;
+    }
+
+    return {};
+}
+
+void RangeAllocator::free(VkDeviceSize offset, VkDeviceSize size) {
+    if (size == 0) {
+        return;
+    }
+
+    auto next = free_ranges.lower_bound(offset);
+
+    // merge with the range right after
+    if (next != free_ranges.end() && next->first == offset + size) {
+        size += next->second;
+        next = free_ranges.erase(next);
+    }
+
+    // merge with the range right before
+    if (next != free_ranges.begin()) {
+        auto prev = std::prev(next);
+        if (prev->first + prev->second == offset) {
+            prev->second += size;
+            return;
+        }
+    }
+
+    free_ranges[offset] = size;
+}
+
+void MeshArena::init(VulkanEngine *engine, VkDeviceSize vertex_block_size,
+                     VkDeviceSize index_block_size) {
+    this->engine = engine;
+    this->vertex_block_size = vertex_block_size;
+    this->index_block_size = index_block_size;
+
+    add_block(vertex_block_size, index_block_size);
+}
+
+void MeshArena::destroy() {
+    for (MeshArenaBlock &block : blocks) {
+        engine->destroy_buffer(block.vertex_buffer);
+        engine->destroy_buffer(block.index_buffer);
+    }
+
+    blocks.clear();
+}
+
+void MeshArena::add_block(VkDeviceSize vertex_size, VkDeviceSize index_size) {
+    MeshArenaBlock block;
+
+    block.vertex_buffer = engine->create_buffer(
+        vertex_size,
+        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT |
+            VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    VkBufferDeviceAddressInfo device_address_info{
+        .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,
+        .buffer = block.vertex_buffer.buffer};
+
+    block.vertex_buffer_address =
+        vkGetBufferDeviceAddress(engine->device, &device_address_info);
+
+    block.index_buffer = engine->create_buffer(
+        index_size,
+        VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+        VMA_MEMORY_USAGE_GPU_ONLY);
+
+    block.vertex_ranges.init(vertex_size);
+    block.index_ranges.init(index_size);
+
+    blocks.push_back(std::move(block));
+}
+
+GPUMeshBuffers MeshArena::allocate(VkDeviceSize vertex_size,
+                                   VkDeviceSize vertex_stride,
+                                   VkDeviceSize index_size,
+                                   VkDeviceSize meshlet_size) {
+    GPUMeshBuffers mesh = {};
+    mesh.vertex_size = vertex_size;
+    mesh.index_size = index_size;
+    mesh.meshlet_size = meshlet_size;
+
+    for (uint32_t i = 0;; i++) {
+        if (i == blocks.size()) {
+            // the stride alignment can waste up to one stride in front of
+            // the meshlets
+            add_block(std::max(vertex_block_size,
+                               vertex_size + meshlet_size + meshlet_alignment),
+                      std::max(index_block_size, index_size));
+        }
+
+        MeshArenaBlock &block = blocks[i];
+
+        std::optional<VkDeviceSize> vertex_offset =
+            block.vertex_ranges.allocate(vertex_size, vertex_stride);
+        if (!vertex_offset) {
+            continue;
+        }
+
+        std::optional<VkDeviceSize> meshlet_offset =
+            block.vertex_ranges.allocate(meshlet_size, meshlet_alignment);
+        if (!meshlet_offset) {
+            block.vertex_ranges.free(*vertex_offset, vertex_size);
+            continue;
+        }
+
+        std::optional<VkDeviceSize> index_offset =
+            block.index_ranges.allocate(index_size, sizeof(uint32_t));
+        if (!index_offset) {
+            block.vertex_ranges.free(*vertex_offset, vertex_size);
+            block.vertex_ranges.free(*meshlet_offset, meshlet_size);
+            continue;
+        }
+
+        mesh.arena_block = i;
+        mesh.vertex_offset = *vertex_offset;
+        mesh.meshlet_offset = *meshlet_offset;
+        mesh.index_offset = *index_offset;
+        break;
+    }
+
+    MeshArenaBlock &block = blocks[mesh.arena_block];
+    mesh.index_buffer = block.index_buffer.buffer;
+    mesh.vertex_buffer_address = block.vertex_buffer_address;
+    mesh.meshlet_buffer_address =
+        block.vertex_buffer_address + mesh.meshlet_offset;
+    mesh.first_index = (uint32_t)(mesh.index_offset / sizeof(uint32_t));
+    mesh.base_vertex = (int32_t)(mesh.vertex_offset / vertex_stride);
+
+    return mesh;
+}
+
+void MeshArena::free(const GPUMeshBuffers &mesh) {
+    MeshArenaBlock &block = blocks[mesh.arena_block];
+
+    block.vertex_ranges.free(mesh.vertex_offset, mesh.vertex_size);
+    block.vertex_ranges.free(mesh.meshlet_offset, mesh.meshlet_size);
+    block.index_ranges.free(mesh.index_offset, mesh.index_size);
+}
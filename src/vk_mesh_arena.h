@@ -0,0 +1,57 @@
+#pragma once
+
+#include "vk_types.h"
+#include <map>
+
+// first fit allocator over a byte range, neighbouring free ranges are merged
+// back together when released
+class RangeAllocator {
+  public:
+    void init(VkDeviceSize size);
+
+    // alignment does not have to be a power of two, vertex ranges are aligned
+    // to the vertex stride so their offset is a whole base vertex
+    std::optional<VkDeviceSize> allocate(VkDeviceSize size,
+                                         VkDeviceSize alignment);
+    void free(VkDeviceSize offset, VkDeviceSize size);
+
+  private:
+    // offset -> size
+    std::map<VkDeviceSize, VkDeviceSize> free_ranges;
+};
+
+struct MeshArenaBlock {
+    AllocatedBuffer vertex_buffer;
+    AllocatedBuffer index_buffer;
+    VkDeviceAddress vertex_buffer_address;
+    RangeAllocator vertex_ranges;
+    RangeAllocator index_ranges;
+};
+
+class VulkanEngine;
+
+// suballocates vertex and index data of every mesh from a few large device
+// local buffers, so draws can share one index buffer bind and one vertex
+// buffer address
+class MeshArena {
+  public:
+    std::vector<MeshArenaBlock> blocks;
+
+    void init(VulkanEngine *engine, VkDeviceSize vertex_block_size,
+              VkDeviceSize index_block_size);
+    void destroy();
+
+    // fills in the arena ranges of a new mesh, a bigger block is created
+    // when no existing one has room. meshlets share the vertex buffer
+    GPUMeshBuffers allocate(VkDeviceSize vertex_size, VkDeviceSize vertex_stride,
+                            VkDeviceSize index_size,
+                            VkDeviceSize meshlet_size = 0);
+    void free(const GPUMeshBuffers &mesh);
+
+  private:
+    VulkanEngine *engine;
+    VkDeviceSize vertex_block_size;
+    VkDeviceSize index_block_size;
+
+    void add_block(VkDeviceSize vertex_size, VkDeviceSize index_size);
+};
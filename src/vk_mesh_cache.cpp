@@ -0,0 +1,383 @@
+#include "vk_mesh_cache.h"
+
+#include <cstring>
+#include <fstream>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+constexpr uint64_t blob_alignment = 16;
+
+static uint64_t align_blob(uint64_t offset) {
+    return (offset + blob_alignment - 1) & ~(blob_alignment - 1);
+}
+
+static uint32_t options_bits(const MeshOptOptions &options) {
+    uint32_t bits = 0;
+    if (options.build_meshlets) {
+        bits |= 1u << 0;
+    }
+    return bits;
+}
+
+bool MappedFile::open(const std::filesystem::path &path) {
+    close();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        return false;
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0) {
+        CloseHandle(file);
+        return false;
+    }
+
+    HANDLE mapping =
+        CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping == nullptr) {
+        CloseHandle(file);
+        return false;
+    }
+
+    void *view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (view == nullptr) {
+        CloseHandle(mapping);
+        CloseHandle(file);
+        return false;
+    }
+
+    file_handle = file;
+    mapping_handle = mapping;
+    bytes = (const uint8_t *)view;
+    byte_count = (size_t)file_size.QuadPart;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void *view = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps the file alive on its own
+    ::close(fd);
+    if (view == MAP_FAILED) {
+        return false;
+    }
+
+    bytes = (const uint8_t *)view;
+    byte_count = (size_t)st.st_size;
+#endif
+
+    return true;
+}
+
+void MappedFile::close() {
+    if (bytes == nullptr) {
+        return;
+    }
+
+#ifdef _WIN32
+    UnmapViewOfFile(bytes);
+    CloseHandle(mapping_handle);
+    CloseHandle(file_handle);
+#else
+    munmap((void *)bytes, byte_count);
+#endif
+
+    bytes = nullptr;
+    byte_count = 0;
+}
+
+bool MeshCache::open(const std::filesystem::path &path, uint64_t source_hash,
+                     const MeshOptOptions &options) {
+    entries = {};
+    scene_nodes = {};
+
+    if (!file.open(path)) {
+        return false;
+    }
+
+    if (file.size() < sizeof(MeshCacheHeader)) {
+        file.close();
+        return false;
+    }
+
+    const MeshCacheHeader *header = (const MeshCacheHeader *)file.data();
+    if (header->magic != mesh_cache_magic ||
+        header->version != mesh_cache_version ||
+        header->source_hash != source_hash ||
+        header->options != options_bits(options)) {
+        file.close();
+        return false;
+    }
+
+    uint64_t table_end = sizeof(MeshCacheHeader) +
+                         (uint64_t)header->mesh_count * sizeof(MeshCacheEntry);
+    if (table_end > file.size()) {
+        file.close();
+        return false;
+    }
+
+    entries = {(const MeshCacheEntry *)(file.data() + sizeof(MeshCacheHeader)),
+               header->mesh_count};
+
+    // a truncated file must not hand out spans past the mapping
+    auto fits = [&](uint64_t offset, uint64_t size) {
+        return offset <= file.size() && size <= file.size() - offset;
+    };
+
+    if (!fits(header->node_offset,
+              (uint64_t)header->node_count * sizeof(SceneNode))) {
+        entries = {};
+        file.close();
+        return false;
+    }
+
+    // parents have to come first and meshes have to exist, SceneGraph
+    // relies on both
+    const SceneNode *nodes =
+        (const SceneNode *)(file.data() + header->node_offset);
+    for (uint32_t i = 0; i < header->node_count; i++) {
+        const SceneNode &node = nodes[i];
+        if ((node.parent != no_parent_node && node.parent >= i) ||
+            node.mesh < -1 || node.mesh >= (int64_t)header->mesh_count) {
+            entries = {};
+            file.close();
+            return false;
+        }
+    }
+    for (const MeshCacheEntry &entry : entries) {
+        if (!fits(entry.name_offset, entry.name_size) ||
+            !fits(entry.surface_offset,
+                  (uint64_t)entry.surface_count * sizeof(GeoSurface)) ||
+            (entry.vertex_format != VertexFormat::Full &&
+             entry.vertex_format != VertexFormat::Packed) ||
+            !fits(entry.vertex_offset,
+                  (uint64_t)entry.vertex_count *
+                      vertex_stride(entry.vertex_format)) ||
+            !fits(entry.index_offset, entry.index_size) ||
+            !fits(entry.meshlet_offset,
+                  (uint64_t)entry.meshlet_count * sizeof(Meshlet))) {
+            entries = {};
+            file.close();
+            return false;
+        }
+
+        // every level and meshlet of every surface has to draw from inside
+        // the mesh index data
+        const GeoSurface *surfaces =
+            (const GeoSurface *)(file.data() + entry.surface_offset);
+        const Meshlet *meshlets =
+            (const Meshlet *)(file.data() + entry.meshlet_offset);
+        for (uint32_t i = 0; i < entry.surface_count; i++) {
+            const GeoSurface &surface = surfaces[i];
+            bool valid = (surface.index_type == VK_INDEX_TYPE_UINT16 ||
+                          surface.index_type == VK_INDEX_TYPE_UINT32) &&
+                         surface.lod_count >= 1 &&
+                         surface.lod_count <= max_lod_count;
+            for (uint32_t l = 0; valid && l < surface.lod_count; l++) {
+                const GeoLod &lod = surface.lods[l];
+                valid = ((uint64_t)lod.start_index + lod.count) *
+                            index_size(surface.index_type) <=
+                        entry.index_size;
+            }
+            valid = valid && (uint64_t)surface.meshlet_offset +
+                                     surface.meshlet_count <=
+                                 entry.meshlet_count;
+            for (uint32_t m = 0; valid && m < surface.meshlet_count; m++) {
+                const Meshlet &meshlet = meshlets[surface.meshlet_offset + m];
+                valid = (uint64_t)meshlet.index_offset +
+                            meshlet.triangle_count * 3 <=
+                        surface.lods[0].count;
+            }
+            if (!valid) {
+                entries = {};
+                file.close();
+                return false;
+            }
+        }
+    }
+
+    scene_nodes = {nodes, header->node_count};
+
+    return true;
+}
+
+MeshView MeshCache::mesh(size_t index) const {
+    const MeshCacheEntry &entry = entries[index];
+    const uint8_t *base = file.data();
+
+    MeshView view;
+    view.name = {(const char *)base + entry.name_offset, entry.name_size};
+    view.surfaces = {(const GeoSurface *)(base + entry.surface_offset),
+                     entry.surface_count};
+    view.index_data = {(const std::byte *)(base + entry.index_offset),
+                       entry.index_size};
+
+    view.vertex_format = entry.vertex_format;
+    view.vertex_data = {(const std::byte *)(base + entry.vertex_offset),
+                        entry.vertex_count * vertex_stride(entry.vertex_format)};
+    view.quant_offset = {entry.quant_offset[0], entry.quant_offset[1],
+                         entry.quant_offset[2]};
+    view.quant_scale = {entry.quant_scale[0], entry.quant_scale[1],
+                        entry.quant_scale[2]};
+
+    view.meshlets = {(const Meshlet *)(base + entry.meshlet_offset),
+                     entry.meshlet_count};
+
+    return view;
+}
+
+bool write_mesh_cache(const std::filesystem::path &path, uint64_t source_hash,
+                      const MeshOptOptions &options,
+                      std::span<const MeshData> meshes,
+                      std::span<const SceneNode> nodes) {
+    std::vector<MeshCacheEntry> entries(meshes.size());
+
+    // lay out the nodes and blobs behind the entry table
+    uint64_t node_offset = align_blob(sizeof(MeshCacheHeader) +
+                                      entries.size() * sizeof(MeshCacheEntry));
+    uint64_t offset =
+        align_blob(node_offset + nodes.size() * sizeof(SceneNode));
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const MeshData &mesh = meshes[i];
+        MeshCacheEntry &entry = entries[i];
+
+        entry.name_offset = offset;
+        entry.name_size = (uint32_t)mesh.name.size();
+        offset = align_blob(offset + entry.name_size);
+
+        entry.surface_offset = offset;
+        entry.surface_count = (uint32_t)mesh.surfaces.size();
+        offset = align_blob(offset + entry.surface_count * sizeof(GeoSurface));
+
+        entry.vertex_offset = offset;
+        entry.vertex_count = (uint32_t)mesh.vertex_count();
+        entry.vertex_format = mesh.vertex_format;
+        for (int c = 0; c < 3; c++) {
+            entry.quant_offset[c] = mesh.quant_offset[c];
+            entry.quant_scale[c] = mesh.quant_scale[c];
+        }
+        offset = align_blob(offset + mesh.vertex_data().size());
+
+        entry.index_offset = offset;
+        entry.index_size = (uint32_t)mesh.index_data().size();
+        offset = align_blob(offset + entry.index_size);
+
+        entry.meshlet_offset = offset;
+        entry.meshlet_count = (uint32_t)mesh.meshlets.size();
+        offset = align_blob(offset + entry.meshlet_count * sizeof(Meshlet));
+    }
+
+    std::vector<uint8_t> blob(offset, 0);
+
+    MeshCacheHeader header = {};
+    header.magic = mesh_cache_magic;
+    header.version = mesh_cache_version;
+    header.source_hash = source_hash;
+    header.options = options_bits(options);
+    header.mesh_count = (uint32_t)meshes.size();
+    header.node_count = (uint32_t)nodes.size();
+    header.node_offset = node_offset;
+
+    memcpy(blob.data(), &header, sizeof(header));
+    memcpy(blob.data() + sizeof(header), entries.data(),
+           entries.size() * sizeof(MeshCacheEntry));
+    memcpy(blob.data() + node_offset, nodes.data(),
+           nodes.size() * sizeof(SceneNode));
+
+    for (size_t i = 0; i < meshes.size(); i++) {
+        const MeshData &mesh = meshes[i];
+        const MeshCacheEntry &entry = entries[i];
+
+        memcpy(blob.data() + entry.name_offset, mesh.name.data(),
+               entry.name_size);
+        memcpy(blob.data() + entry.surface_offset, mesh.surfaces.data(),
+               entry.surface_count * sizeof(GeoSurface));
+        memcpy(blob.data() + entry.vertex_offset, mesh.vertex_data().data(),
+               mesh.vertex_data().size());
+        memcpy(blob.data() + entry.index_offset, mesh.index_data().data(),
+               entry.index_size);
+        memcpy(blob.data() + entry.meshlet_offset, mesh.meshlets.data(),
+               entry.meshlet_count * sizeof(Meshlet));
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    // write next to the target and rename so a crash never leaves a
+    // half written cache behind
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file.write((const char *)blob.data(), blob.size());
+        if (!file) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
+
+uint64_t hash_file(const std::filesystem::path &path) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return 0;
+    }
+
+    // FNV-1a over 8 byte words, only used to notice stale caches
+    constexpr uint64_t prime = 0x100000001b3;
+    uint64_t hash = 0xcbf29ce484222325 ^ file.size();
+
+    const uint8_t *bytes = file.data();
+    size_t word_count = file.size() / sizeof(uint64_t);
+    for (size_t i = 0; i < word_count; i++) {
+        uint64_t word;
+        memcpy(&word, bytes + i * sizeof(uint64_t), sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+    for (size_t i = word_count * sizeof(uint64_t); i < file.size(); i++) {
+        hash = (hash ^ bytes[i]) * prime;
+    }
+
+    return hash;
+}
+
+std::filesystem::path
+mesh_cache_path(const std::filesystem::path &source,
+                const std::filesystem::path &source_root,
+                const std::filesystem::path &cache_root) {
+    std::filesystem::path name = source.lexically_relative(source_root);
+    if (name.empty() || *name.begin() == "..") {
+        name = source.filename();
+    }
+
+    std::filesystem::path path = cache_root / name;
+    path += ".gmesh";
+
+    return path;
+}
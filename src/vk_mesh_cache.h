@@ -0,0 +1,102 @@
+#pragma once
+
+#include "vk_loader.h"
+#include "vk_meshopt.h"
+
+// baked mesh cache, stores decoded meshes in the layout they are uploaded in
+// so a warm load is a memory map and a copy into staging.
+//
+// file layout, every blob starts 16 byte aligned:
+//   MeshCacheHeader
+//   MeshCacheEntry[mesh_count]
+//   SceneNode[node_count]
+//   per mesh: name, GeoSurface[], Vertex[] or PackedVertex[], index data,
+//             Meshlet[]
+// index data mixes 16 and 32 bit ranges as described by the surfaces
+constexpr uint32_t mesh_cache_magic = 0x48534d47; // "GMSH"
+constexpr uint32_t mesh_cache_version = 8;
+
+struct MeshCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    // hash of the source file the cache was baked from
+    uint64_t source_hash;
+    // MeshOptOptions the meshes were optimized with, one bit per option
+    uint32_t options;
+    uint32_t mesh_count;
+    uint32_t node_count;
+    uint64_t node_offset;
+};
+
+struct MeshCacheEntry {
+    uint64_t name_offset;
+    uint64_t surface_offset;
+    uint64_t vertex_offset;
+    uint64_t index_offset;
+    uint64_t meshlet_offset;
+    uint32_t name_size;
+    uint32_t surface_count;
+    uint32_t vertex_count;
+    // in bytes
+    uint32_t index_size;
+    VertexFormat vertex_format;
+    float quant_offset[3];
+    float quant_scale[3];
+    uint32_t meshlet_count;
+};
+
+// read only memory mapping of a whole file
+class MappedFile {
+  public:
+    MappedFile() = default;
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::filesystem::path &path);
+    void close();
+
+    const uint8_t *data() const { return bytes; }
+    size_t size() const { return byte_count; }
+
+  private:
+    const uint8_t *bytes{nullptr};
+    size_t byte_count{0};
+#ifdef _WIN32
+    void *file_handle{nullptr};
+    void *mapping_handle{nullptr};
+#endif
+};
+
+class MeshCache {
+  public:
+    // fails when the file is missing, malformed or baked from another source
+    // or with other options
+    bool open(const std::filesystem::path &path, uint64_t source_hash,
+              const MeshOptOptions &options);
+
+    size_t mesh_count() const { return entries.size(); }
+    // the spans point into the mapping
+    MeshView mesh(size_t index) const;
+    // depth first, points into the mapping
+    std::span<const SceneNode> nodes() const { return scene_nodes; }
+
+  private:
+    MappedFile file;
+    std::span<const MeshCacheEntry> entries;
+    std::span<const SceneNode> scene_nodes;
+};
+
+bool write_mesh_cache(const std::filesystem::path &path, uint64_t source_hash,
+                      const MeshOptOptions &options,
+                      std::span<const MeshData> meshes,
+                      std::span<const SceneNode> nodes);
+
+uint64_t hash_file(const std::filesystem::path &path);
+
+// where the baked cache of a source asset lives, sources below source_root
+// keep their relative path under cache_root
+std::filesystem::path
+mesh_cache_path(const std::filesystem::path &source,
+                const std::filesystem::path &source_root = "assets",
+                const std::filesystem::path &cache_root = "cache");
@@ -0,0 +1,863 @@
+#include "vk_meshopt.h"
+#include "vk_bounds.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+#include <glm/packing.hpp>
+
+namespace {
+// vertices are compared bit for bit, Vertex has no padding
+struct VertexBytesHash {
+    size_t operator()(const Vertex &v) const {
+        const uint32_t *words = (const uint32_t *)&v;
+        uint64_t hash = 0xcbf29ce484222325;
+        for (size_t i = 0; i < sizeof(Vertex) / sizeof(uint32_t); i++) {
+            hash = (hash ^ words[i]) * 0x100000001b3;
+        }
+        return (size_t)hash;
+    }
+};
+
+struct VertexBytesEqual {
+    bool operator()(const Vertex &a, const Vertex &b) const {
+        return memcmp(&a, &b, sizeof(Vertex)) == 0;
+    }
+};
+} // namespace
+
+void weld_vertices(MeshData &mesh) {
+    std::unordered_map<Vertex, uint32_t, VertexBytesHash, VertexBytesEqual>
+        unique;
+    unique.reserve(mesh.vertices.size());
+
+    std::vector<Vertex> welded;
+    welded.reserve(mesh.vertices.size());
+
+    // vertices end up in order of first use, which also helps fetch locality
+    for (uint32_t &idx : mesh.indices) {
+        auto [it, inserted] =
+            unique.try_emplace(mesh.vertices[idx], (uint32_t)welded.size());
+        if (inserted) {
+            welded.push_back(mesh.vertices[idx]);
+        }
+        idx = it->second;
+    }
+
+    mesh.vertices = std::move(welded);
+}
+
+void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count,
+                           uint32_t cache_size) {
+    size_t triangle_count = indices.size() / 3;
+    if (triangle_count == 0) {
+        return;
+    }
+
+    // vertex -> triangle adjacency, packed per vertex
+    std::vector<uint32_t> live(vertex_count, 0);
+    for (uint32_t idx : indices) {
+        live[idx]++;
+    }
+
+    std::vector<uint32_t> offsets(vertex_count + 1, 0);
+    for (size_t v = 0; v < vertex_count; v++) {
+        offsets[v + 1] = offsets[v] + live[v];
+    }
+
+    std::vector<uint32_t> adjacency(indices.size());
+    std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+    for (uint32_t t = 0; t < triangle_count; t++) {
+        for (uint32_t c = 0; c < 3; c++) {
+            adjacency[fill[indices[3 * t + c]]++] = t;
+        }
+    }
+
+    std::vector<uint32_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint32_t> dead_end;
+    std::vector<uint32_t> candidates;
+
+    std::vector<uint32_t> output;
+    output.reserve(indices.size());
+
+    // starts past the cache size so no vertex begins cached
+    uint32_t time = cache_size + 1;
+    size_t cursor = 0;
+
+    // most recently touched vertex with triangles left, otherwise the next
+    // one in input order
+    auto skip_dead_end = [&]() -> int64_t {
+        while (!dead_end.empty()) {
+            uint32_t d = dead_end.back();
+            dead_end.pop_back();
+            if (live[d] > 0) {
+                return d;
+            }
+        }
+
+        while (cursor < vertex_count) {
+            if (live[cursor] > 0) {
+                return (int64_t)cursor;
+            }
+            cursor++;
+        }
+
+        return -1;
+    };
+
+    int64_t fanning = skip_dead_end();
+    while (fanning >= 0) {
+        candidates.clear();
+
+        // emit every remaining triangle around the fanning vertex
+        for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; k++) {
+            uint32_t t = adjacency[k];
+            if (emitted[t]) {
+                continue;
+            }
+            emitted[t] = true;
+
+            for (uint32_t c = 0; c < 3; c++) {
+                uint32_t v = indices[3 * t + c];
+                output.push_back(v);
+                dead_end.push_back(v);
+                candidates.push_back(v);
+                live[v]--;
+
+                if (time - cache_time[v] > cache_size) {
+                    cache_time[v] = time;
+                    time++;
+                }
+            }
+        }
+
+        // next fan around the oldest candidate that stays cached while its
+        // own triangles are emitted
+        int64_t next = -1;
+        uint32_t best = 0;
+        for (uint32_t v : candidates) {
+            if (live[v] == 0) {
+                continue;
+            }
+
+            uint32_t priority = 0;
+            if (time - cache_time[v] + 2 * live[v] <= cache_size) {
+                priority = time - cache_time[v];
+            }
+            if (priority > best) {
+                best = priority;
+                next = v;
+            }
+        }
+
+        if (next == -1) {
+            next = skip_dead_end();
+        }
+        fanning = next;
+    }
+
+    std::copy(output.begin(), output.end(), indices.begin());
+}
+
+void optimize_vertex_fetch(MeshData &mesh) {
+    std::vector<uint32_t> remap(mesh.vertices.size(), UINT32_MAX);
+
+    std::vector<Vertex> ordered;
+    ordered.reserve(mesh.vertices.size());
+
+    for (uint32_t &idx : mesh.indices) {
+        if (remap[idx] == UINT32_MAX) {
+            remap[idx] = (uint32_t)ordered.size();
+            ordered.push_back(mesh.vertices[idx]);
+        }
+        idx = remap[idx];
+    }
+
+    mesh.vertices = std::move(ordered);
+}
+
+uint32_t count_vertex_transforms(std::span<const uint32_t> indices,
+                                 size_t vertex_count, uint32_t cache_size) {
+    // a vertex stays in the fifo until cache_size newer misses pushed it out
+    std::vector<uint32_t> cached_at(vertex_count, 0);
+    uint32_t time = cache_size + 1;
+    uint32_t misses = 0;
+
+    for (uint32_t idx : indices) {
+        if (time - cached_at[idx] > cache_size) {
+            cached_at[idx] = time;
+            time++;
+            misses++;
+        }
+    }
+
+    return misses;
+}
+
+// octahedral mapping of a unit vector onto [-1, 1]^2
+static glm::vec2 oct_encode(glm::vec3 n) {
+    float l1 = std::fabs(n.x) + std::fabs(n.y) + std::fabs(n.z);
+    if (l1 == 0.f) {
+        return {0.f, 0.f};
+    }
+    n /= l1;
+
+    if (n.z >= 0.f) {
+        return {n.x, n.y};
+    }
+
+    // fold the lower hemisphere over the diagonals
+    return {(1.f - std::fabs(n.y)) * (n.x >= 0.f ? 1.f : -1.f),
+            (1.f - std::fabs(n.x)) * (n.y >= 0.f ? 1.f : -1.f)};
+}
+
+bool quantize_vertices(MeshData &mesh) {
+    if (mesh.vertex_format == VertexFormat::Packed || mesh.vertices.empty()) {
+        return false;
+    }
+
+    glm::vec3 min = mesh.vertices[0].position;
+    glm::vec3 max = mesh.vertices[0].position;
+    for (const Vertex &v : mesh.vertices) {
+        min = glm::min(min, v.position);
+        max = glm::max(max, v.position);
+    }
+
+    glm::vec3 extent = max - min;
+    float largest = std::max(extent.x, std::max(extent.y, extent.z));
+    if (largest / 65535.f * 0.5f > max_quantization_error) {
+        return false;
+    }
+
+    // flat axes still need a non zero scale to divide by
+    for (int i = 0; i < 3; i++) {
+        if (extent[i] == 0.f) {
+            extent[i] = 1.f;
+        }
+    }
+
+    mesh.packed_vertices.resize(mesh.vertices.size());
+    for (size_t i = 0; i < mesh.vertices.size(); i++) {
+        const Vertex &v = mesh.vertices[i];
+        PackedVertex &p = mesh.packed_vertices[i];
+
+        glm::vec3 unorm = (v.position - min) / extent;
+        p.position_xy = glm::packUnorm2x16(glm::vec2(unorm.x, unorm.y));
+        p.position_z = glm::packUnorm2x16(glm::vec2(unorm.z, 0.f));
+        p.normal = glm::packSnorm2x16(oct_encode(v.normal));
+        p.uv = glm::packHalf2x16(glm::vec2(v.uv_x, v.uv_y));
+        p.color = glm::packUnorm4x8(glm::clamp(v.color, 0.f, 1.f));
+    }
+
+    mesh.vertex_format = VertexFormat::Packed;
+    mesh.quant_offset = min;
+    mesh.quant_scale = extent;
+
+    mesh.vertices.clear();
+    mesh.vertices.shrink_to_fit();
+
+    return true;
+}
+
+namespace {
+// symmetric 4x4 error quadric, sum of squared distances to a set of planes
+struct Quadric {
+    double a00, a01, a02, a03;
+    double a11, a12, a13;
+    double a22, a23;
+    double a33;
+    // summed plane area, the error is normalized by it
+    double weight;
+
+    static Quadric from_plane(glm::vec3 n, double d, double weight) {
+        Quadric q;
+        q.a00 = n.x * n.x * weight;
+        q.a01 = n.x * n.y * weight;
+        q.a02 = n.x * n.z * weight;
+        q.a03 = n.x * d * weight;
+        q.a11 = n.y * n.y * weight;
+        q.a12 = n.y * n.z * weight;
+        q.a13 = n.y * d * weight;
+        q.a22 = n.z * n.z * weight;
+        q.a23 = n.z * d * weight;
+        q.a33 = d * d * weight;
+        q.weight = weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &o) {
+        a00 += o.a00, a01 += o.a01, a02 += o.a02, a03 += o.a03;
+        a11 += o.a11, a12 += o.a12, a13 += o.a13;
+        a22 += o.a22, a23 += o.a23;
+        a33 += o.a33;
+        weight += o.weight;
+        return *this;
+    }
+
+    // root mean squared distance of p to the planes
+    double error(glm::vec3 position) const {
+        double p[3] = {position.x, position.y, position.z};
+        double e =
+            a00 * p[0] * p[0] + a11 * p[1] * p[1] + a22 * p[2] * p[2] +
+            2 * (a01 * p[0] * p[1] + a02 * p[0] * p[2] + a12 * p[1] * p[2]) +
+            2 * (a03 * p[0] + a13 * p[1] + a23 * p[2]) + a33;
+        return weight > 0 ? std::sqrt(std::max(e, 0.0) / weight) : 0.0;
+    }
+};
+
+struct Collapse {
+    uint32_t from;
+    uint32_t to;
+    float error;
+};
+} // namespace
+
+std::vector<uint32_t> simplify_indices(std::span<const uint32_t> indices,
+                                       std::span<const Vertex> vertices,
+                                       size_t target_index_count,
+                                       float target_error,
+                                       float *result_error) {
+    std::vector<uint32_t> result(indices.begin(), indices.end());
+    float max_error = 0.f;
+
+    std::vector<Quadric> quadrics(vertices.size(), Quadric{});
+    for (size_t t = 0; t + 2 < result.size(); t += 3) {
+        glm::vec3 p0 = vertices[result[t + 0]].position;
+        glm::vec3 p1 = vertices[result[t + 1]].position;
+        glm::vec3 p2 = vertices[result[t + 2]].position;
+
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        if (area == 0.f) {
+            continue;
+        }
+        n /= area;
+
+        Quadric q = Quadric::from_plane(n, -glm::dot(n, p0), area);
+        quadrics[result[t + 0]] += q;
+        quadrics[result[t + 1]] += q;
+        quadrics[result[t + 2]] += q;
+    }
+
+    // edges used by a single triangle are mesh borders or attribute seams,
+    // moving their vertices would open holes so they stay put
+    std::vector<bool> locked(vertices.size(), false);
+    {
+        std::unordered_map<uint64_t, uint32_t> edge_use;
+        auto edge_key = [](uint32_t a, uint32_t b) {
+            return a < b ? (uint64_t)a << 32 | b : (uint64_t)b << 32 | a;
+        };
+        for (size_t t = 0; t + 2 < result.size(); t += 3) {
+            for (int e = 0; e < 3; e++) {
+                edge_use[edge_key(result[t + e], result[t + (e + 1) % 3])]++;
+            }
+        }
+        for (auto [key, count] : edge_use) {
+            if (count == 1) {
+                locked[key >> 32] = true;
+                locked[key & 0xffffffff] = true;
+            }
+        }
+    }
+
+    auto normal = [&](uint32_t a, uint32_t b, uint32_t c) {
+        glm::vec3 p0 = vertices[a].position;
+        return glm::cross(vertices[b].position - p0, vertices[c].position - p0);
+    };
+
+    std::vector<uint32_t> remap(vertices.size());
+    std::vector<bool> touched(vertices.size());
+    std::vector<uint32_t> triangle_offsets(vertices.size() + 1);
+    std::vector<uint32_t> vertex_triangles;
+    std::vector<Collapse> collapses;
+
+    // every pass collapses the cheapest edges whose neighbourhoods do not
+    // overlap, then rebuilds the index list
+    while (result.size() > target_index_count) {
+        size_t triangle_count = result.size() / 3;
+
+        std::fill(triangle_offsets.begin(), triangle_offsets.end(), 0);
+        for (uint32_t idx : result) {
+            triangle_offsets[idx + 1]++;
+        }
+        for (size_t v = 0; v < vertices.size(); v++) {
+            triangle_offsets[v + 1] += triangle_offsets[v];
+        }
+        vertex_triangles.resize(result.size());
+        {
+            std::vector<uint32_t> fill(triangle_offsets.begin(),
+                                       triangle_offsets.end() - 1);
+            for (size_t t = 0; t < triangle_count; t++) {
+                for (int c = 0; c < 3; c++) {
+                    vertex_triangles[fill[result[3 * t + c]]++] = (uint32_t)t;
+                }
+            }
+        }
+
+        collapses.clear();
+        for (size_t t = 0; t < triangle_count; t++) {
+            for (int e = 0; e < 3; e++) {
+                uint32_t a = result[3 * t + e];
+                uint32_t b = result[3 * t + (e + 1) % 3];
+                for (auto [from, to] : {std::pair{a, b}, std::pair{b, a}}) {
+                    if (locked[from]) {
+                        continue;
+                    }
+                    Quadric q = quadrics[from];
+                    q += quadrics[to];
+                    collapses.push_back(
+                        {from, to, (float)q.error(vertices[to].position)});
+                }
+            }
+        }
+        std::sort(collapses.begin(), collapses.end(),
+                  [](const Collapse &a, const Collapse &b) {
+                      return a.error < b.error;
+                  });
+
+        for (size_t v = 0; v < vertices.size(); v++) {
+            remap[v] = (uint32_t)v;
+        }
+        std::fill(touched.begin(), touched.end(), false);
+
+        // each collapse removes about two triangles
+        size_t budget = (result.size() - target_index_count) / 6 + 1;
+        size_t collapsed = 0;
+
+        for (const Collapse &collapse : collapses) {
+            if (collapse.error > target_error || collapsed >= budget) {
+                break;
+            }
+            if (touched[collapse.from] || touched[collapse.to]) {
+                continue;
+            }
+
+            std::span<const uint32_t> around(
+                vertex_triangles.data() + triangle_offsets[collapse.from],
+                triangle_offsets[collapse.from + 1] -
+                    triangle_offsets[collapse.from]);
+
+            // reject collapses that would fold a remaining triangle over
+            bool flips = false;
+            for (uint32_t t : around) {
+                uint32_t tri[3] = {result[3 * t], result[3 * t + 1],
+                                   result[3 * t + 2]};
+                if (tri[0] == collapse.to || tri[1] == collapse.to ||
+                    tri[2] == collapse.to) {
+                    continue;
+                }
+                glm::vec3 before = normal(tri[0], tri[1], tri[2]);
+                for (uint32_t &idx : tri) {
+                    if (idx == collapse.from) {
+                        idx = collapse.to;
+                    }
+                }
+                glm::vec3 after = normal(tri[0], tri[1], tri[2]);
+                if (glm::dot(before, after) <= 0.f) {
+                    flips = true;
+                    break;
+                }
+            }
+            if (flips) {
+                continue;
+            }
+
+            // lock the whole neighbourhood so later collapses in this pass
+            // see the triangles they check unchanged
+            for (uint32_t t : around) {
+                for (int c = 0; c < 3; c++) {
+                    touched[result[3 * t + c]] = true;
+                }
+            }
+
+            remap[collapse.from] = collapse.to;
+            quadrics[collapse.to] += quadrics[collapse.from];
+            max_error = std::max(max_error, collapse.error);
+            collapsed++;
+        }
+
+        if (collapsed == 0) {
+            break;
+        }
+
+        size_t write = 0;
+        for (size_t t = 0; t < triangle_count; t++) {
+            uint32_t a = remap[result[3 * t + 0]];
+            uint32_t b = remap[result[3 * t + 1]];
+            uint32_t c = remap[result[3 * t + 2]];
+            if (a == b || b == c || c == a) {
+                continue;
+            }
+            result[write++] = a;
+            result[write++] = b;
+            result[write++] = c;
+        }
+        result.resize(write);
+    }
+
+    if (result_error) {
+        *result_error = max_error;
+    }
+
+    return result;
+}
+
+void generate_lods(MeshData &mesh) {
+    for (GeoSurface &surface : mesh.surfaces) {
+        surface.lod_count = 1;
+        surface.lods[0].error = 0.f;
+
+        // each level is simplified from the one before, errors add up
+        while (surface.lod_count < max_lod_count) {
+            const GeoLod &previous = surface.lods[surface.lod_count - 1];
+            if (previous.count / 3 < min_lod_triangles * 2) {
+                break;
+            }
+
+            float error = 0.f;
+            std::vector<uint32_t> simplified = simplify_indices(
+                std::span(mesh.indices)
+                    .subspan(previous.start_index, previous.count),
+                mesh.vertices, previous.count / 6 * 3,
+                surface.bounds.radius * max_lod_relative_error, &error);
+
+            // a level that barely shrinks costs memory without saving work
+            if (simplified.size() > previous.count * 3 / 4) {
+                break;
+            }
+
+            optimize_vertex_cache(simplified, mesh.vertices.size());
+
+            GeoLod &lod = surface.lods[surface.lod_count++];
+            lod.start_index = (uint32_t)mesh.indices.size();
+            lod.count = (uint32_t)simplified.size();
+            lod.error = previous.error + error;
+            lod.first_index = 0;
+
+            mesh.indices.insert(mesh.indices.end(), simplified.begin(),
+                                simplified.end());
+        }
+    }
+}
+
+void pack_indices(MeshData &mesh) {
+    if (mesh.indices.empty()) {
+        return;
+    }
+
+    std::vector<std::byte> packed;
+    packed.reserve(mesh.indices.size() * sizeof(uint32_t));
+
+    for (GeoSurface &surface : mesh.surfaces) {
+        // coarser levels only use vertices of the full detail one
+        uint32_t min_vertex = UINT32_MAX;
+        uint32_t max_vertex = 0;
+        for (uint32_t i = 0; i < surface.lod_count; i++) {
+            const GeoLod &lod = surface.lods[i];
+            for (uint32_t idx : std::span(mesh.indices)
+                                    .subspan(lod.start_index, lod.count)) {
+                min_vertex = std::min(min_vertex, idx);
+                max_vertex = std::max(max_vertex, idx);
+            }
+        }
+
+        // fetch order keeps a surface's vertices close together, so most
+        // ranges fit even when the whole mesh does not
+        bool empty = min_vertex > max_vertex;
+        bool fits_16 = empty || max_vertex - min_vertex <= UINT16_MAX;
+        surface.index_type =
+            fits_16 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+        surface.vertex_offset = fits_16 && !empty ? min_vertex : 0;
+
+        // 32 bit ranges must start 4 byte aligned, pad after odd 16 bit ones
+        size_t element_size = index_size(surface.index_type);
+        packed.resize((packed.size() + sizeof(uint32_t) - 1) &
+                      ~(sizeof(uint32_t) - 1));
+
+        for (uint32_t i = 0; i < surface.lod_count; i++) {
+            GeoLod &lod = surface.lods[i];
+            std::span<const uint32_t> indices =
+                std::span(mesh.indices).subspan(lod.start_index, lod.count);
+
+            size_t offset = packed.size();
+            lod.start_index = (uint32_t)(offset / element_size);
+
+            packed.resize(offset + indices.size() * element_size);
+            if (fits_16) {
+                uint16_t *out = (uint16_t *)(packed.data() + offset);
+                for (size_t j = 0; j < indices.size(); j++) {
+                    out[j] = (uint16_t)(indices[j] - surface.vertex_offset);
+                }
+            } else {
+                memcpy(packed.data() + offset, indices.data(),
+                       indices.size() * sizeof(uint32_t));
+            }
+        }
+    }
+
+    packed.resize((packed.size() + sizeof(uint32_t) - 1) &
+                  ~(sizeof(uint32_t) - 1));
+
+    mesh.packed_indices = std::move(packed);
+    mesh.indices.clear();
+    mesh.indices.shrink_to_fit();
+}
+
+static Meshlet finish_meshlet(std::span<const uint32_t> indices,
+                              std::span<const uint32_t> vertices,
+                              std::span<const Vertex> mesh_vertices) {
+    Meshlet meshlet = {};
+    meshlet.triangle_count = (uint32_t)(indices.size() / 3);
+    meshlet.vertex_count = (uint32_t)vertices.size();
+
+    glm::vec3 min = mesh_vertices[vertices[0]].position;
+    glm::vec3 max = min;
+    for (uint32_t v : vertices) {
+        min = glm::min(min, mesh_vertices[v].position);
+        max = glm::max(max, mesh_vertices[v].position);
+    }
+    meshlet.center = (min + max) * 0.5f;
+    for (uint32_t v : vertices) {
+        meshlet.radius =
+            std::max(meshlet.radius,
+                     glm::length(mesh_vertices[v].position - meshlet.center));
+    }
+
+    // the cone axis is the area weighted mean normal, the cutoff is the sine
+    // of the widest angle any triangle normal makes with it
+    std::vector<glm::vec3> normals;
+    normals.reserve(meshlet.triangle_count);
+    glm::vec3 axis{0.f};
+    for (size_t t = 0; t < indices.size(); t += 3) {
+        glm::vec3 p0 = mesh_vertices[indices[t + 0]].position;
+        glm::vec3 p1 = mesh_vertices[indices[t + 1]].position;
+        glm::vec3 p2 = mesh_vertices[indices[t + 2]].position;
+        glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+        float area = glm::length(n);
+        if (area > 0.f) {
+            axis += n;
+            normals.push_back(n / area);
+        }
+    }
+
+    meshlet.cone_axis = glm::vec3{0.f, 0.f, 1.f};
+    meshlet.cone_cutoff = 1.f;
+
+    float axis_length = glm::length(axis);
+    if (axis_length == 0.f || normals.empty()) {
+        return meshlet;
+    }
+    axis /= axis_length;
+
+    float min_dot = 1.f;
+    for (glm::vec3 n : normals) {
+        min_dot = std::min(min_dot, glm::dot(n, axis));
+    }
+
+    // normals spread over a hemisphere or more, the cone never culls
+    meshlet.cone_axis = axis;
+    if (min_dot > 0.f) {
+        meshlet.cone_cutoff = std::sqrt(1.f - min_dot * min_dot);
+    }
+
+    return meshlet;
+}
+
+void build_meshlets(MeshData &mesh) {
+    mesh.meshlets.clear();
+
+    for (GeoSurface &surface : mesh.surfaces) {
+        surface.meshlet_offset = (uint32_t)mesh.meshlets.size();
+        surface.meshlet_count = 0;
+
+        std::span<uint32_t> indices = std::span(mesh.indices).subspan(
+            surface.lods[0].start_index, surface.lods[0].count);
+        size_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) {
+            continue;
+        }
+
+        // vertex -> triangle adjacency, packed per vertex
+        std::vector<uint32_t> offsets(mesh.vertices.size() + 1, 0);
+        for (uint32_t idx : indices) {
+            offsets[idx + 1]++;
+        }
+        for (size_t v = 0; v < mesh.vertices.size(); v++) {
+            offsets[v + 1] += offsets[v];
+        }
+        std::vector<uint32_t> adjacency(indices.size());
+        {
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (size_t t = 0; t < triangle_count; t++) {
+                for (int c = 0; c < 3; c++) {
+                    adjacency[fill[indices[3 * t + c]]++] = (uint32_t)t;
+                }
+            }
+        }
+
+        std::vector<bool> emitted(triangle_count, false);
+        // id of the meshlet a vertex was last added to
+        std::vector<uint32_t> owner(mesh.vertices.size(), UINT32_MAX);
+        std::vector<uint32_t> output;
+        output.reserve(indices.size());
+
+        std::vector<uint32_t> meshlet_vertices;
+        std::vector<uint32_t> candidates;
+        size_t seed = 0;
+
+        // grow every meshlet from a seed triangle, always taking the
+        // neighbouring triangle that adds the fewest new vertices. seeds
+        // follow the cache optimized order so meshlets stay compact
+        while (true) {
+            while (seed < triangle_count && emitted[seed]) {
+                seed++;
+            }
+            if (seed == triangle_count) {
+                break;
+            }
+
+            uint32_t id = (uint32_t)mesh.meshlets.size();
+            size_t meshlet_begin = output.size();
+            meshlet_vertices.clear();
+            candidates.clear();
+
+            auto new_vertices = [&](uint32_t t) {
+                uint32_t count = 0;
+                for (int c = 0; c < 3; c++) {
+                    count += owner[indices[3 * t + c]] != id;
+                }
+                return count;
+            };
+
+            uint32_t next = (uint32_t)seed;
+            while (next != UINT32_MAX) {
+                emitted[next] = true;
+                for (int c = 0; c < 3; c++) {
+                    uint32_t v = indices[3 * next + c];
+                    output.push_back(v);
+                    if (owner[v] != id) {
+                        owner[v] = id;
+                        meshlet_vertices.push_back(v);
+                        candidates.insert(candidates.end(),
+                                          adjacency.begin() + offsets[v],
+                                          adjacency.begin() + offsets[v + 1]);
+                    }
+                }
+
+                if ((output.size() - meshlet_begin) / 3 ==
+                    max_meshlet_triangles) {
+                    break;
+                }
+
+                next = UINT32_MAX;
+                uint32_t best_score = UINT32_MAX;
+                for (uint32_t t : candidates) {
+                    if (emitted[t]) {
+                        continue;
+                    }
+                    uint32_t score = new_vertices(t);
+                    if (score < best_score &&
+                        meshlet_vertices.size() + score <=
+                            max_meshlet_vertices) {
+                        best_score = score;
+                        next = t;
+                    }
+                }
+
+                // drop emitted triangles so the scans stay short
+                std::erase_if(candidates,
+                              [&](uint32_t t) { return emitted[t]; });
+            }
+
+            std::span<uint32_t> meshlet_indices(output.data() + meshlet_begin,
+                                                output.size() - meshlet_begin);
+            Meshlet meshlet = finish_meshlet(meshlet_indices, meshlet_vertices,
+                                             mesh.vertices);
+            meshlet.index_offset = (uint32_t)meshlet_begin;
+
+            // restore cache order inside the meshlet
+            optimize_vertex_cache(meshlet_indices, mesh.vertices.size());
+
+            mesh.meshlets.push_back(meshlet);
+            surface.meshlet_count++;
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin());
+    }
+}
+
+void compute_surface_bounds(MeshData &mesh) {
+    std::vector<uint32_t> seen_by(mesh.vertices.size(), UINT32_MAX);
+    std::vector<float> x, y, z;
+
+    for (uint32_t s = 0; s < mesh.surfaces.size(); s++) {
+        GeoSurface &surface = mesh.surfaces[s];
+        std::span<const uint32_t> indices = std::span(mesh.indices).subspan(
+            surface.lods[0].start_index, surface.lods[0].count);
+
+        // gather each used position once into flat arrays so the reduction
+        // runs over contiguous floats
+        x.clear();
+        y.clear();
+        z.clear();
+        for (uint32_t idx : indices) {
+            if (seen_by[idx] != s) {
+                seen_by[idx] = s;
+                const glm::vec3 &p = mesh.vertices[idx].position;
+                x.push_back(p.x);
+                y.push_back(p.y);
+                z.push_back(p.z);
+            }
+        }
+
+        surface.bounds = compute_bounds(x.data(), y.data(), z.data(), x.size());
+    }
+}
+
+MeshOptStats optimize_mesh(MeshData &mesh, const MeshOptOptions &options) {
+    weld_vertices(mesh);
+
+    MeshOptStats stats = {};
+    stats.triangle_count = (uint32_t)(mesh.indices.size() / 3);
+    stats.transforms_before =
+        count_vertex_transforms(mesh.indices, mesh.vertices.size());
+
+    // triangles only move inside their own surface
+    for (const GeoSurface &surface : mesh.surfaces) {
+        optimize_vertex_cache(std::span(mesh.indices)
+                                  .subspan(surface.lods[0].start_index,
+                                           surface.lods[0].count),
+                              mesh.vertices.size());
+    }
+
+    if (options.build_meshlets) {
+        build_meshlets(mesh);
+        stats.meshlet_count = (uint32_t)mesh.meshlets.size();
+    }
+
+    optimize_vertex_fetch(mesh);
+
+    stats.transforms_after =
+        count_vertex_transforms(mesh.indices, mesh.vertices.size());
+
+    // simplified levels reuse the full detail vertices, so they come after
+    // fetch ordering
+    compute_surface_bounds(mesh);
+    generate_lods(mesh);
+    stats.lod_triangle_count =
+        (uint32_t)(mesh.indices.size() / 3) - stats.triangle_count;
+
+    // has to stay last, the stages above work on full vertices
+    stats.vertex_bytes_before = mesh.vertex_data().size();
+    quantize_vertices(mesh);
+    stats.vertex_bytes_after = mesh.vertex_data().size();
+
+    stats.index_bytes_before = mesh.index_data().size();
+    pack_indices(mesh);
+    stats.index_bytes_after = mesh.index_data().size();
+
+    return stats;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "vk_loader.h"
+
+// import time mesh optimization stages, run once per mesh by import_asset
+// so their cost is paid when cooking instead of at every load
+
+// fifo size the post transform cache is modelled with
+constexpr uint32_t vertex_cache_size = 16;
+
+// largest position error quantization may add, in mesh units
+constexpr float max_quantization_error = 0.0005f;
+
+// simplification stops once a level would deviate by more than this
+// fraction of the surface radius
+constexpr float max_lod_relative_error = 0.05f;
+// surfaces below twice this many triangles get no further levels
+constexpr uint32_t min_lod_triangles = 64;
+
+struct MeshOptOptions {
+    // split full detail surfaces into meshlets for cluster culling
+    bool build_meshlets{true};
+};
+
+struct MeshOptStats {
+    uint32_t triangle_count;
+    // triangles of all simplified levels together
+    uint32_t lod_triangle_count;
+    uint32_t meshlet_count;
+    // simulated vertex shader invocations before and after reordering
+    uint32_t transforms_before;
+    uint32_t transforms_after;
+    // vertex buffer size as imported and as it will be uploaded
+    size_t vertex_bytes_before;
+    size_t vertex_bytes_after;
+    size_t index_bytes_before;
+    size_t index_bytes_after;
+};
+
+// merges bit identical vertices and remaps the indices onto them
+void weld_vertices(MeshData &mesh);
+
+// reorders the triangles of one index range for post transform cache hits
+// (tipsify, Sander et al. 2007)
+void optimize_vertex_cache(std::span<uint32_t> indices, size_t vertex_count,
+                           uint32_t cache_size = vertex_cache_size);
+
+// renumbers vertices in order of first use so fetches walk memory forwards
+void optimize_vertex_fetch(MeshData &mesh);
+
+// vertex shader invocations a fifo cache of cache_size needs for the indices,
+// divide by the triangle count for the ACMR
+uint32_t count_vertex_transforms(std::span<const uint32_t> indices,
+                                 size_t vertex_count,
+                                 uint32_t cache_size = vertex_cache_size);
+
+// splits every surface's full detail triangles into meshlets of at most
+// max_meshlet_vertices and max_meshlet_triangles, reordering the triangles
+// so each meshlet is one contiguous index range
+void build_meshlets(MeshData &mesh);
+
+// box and sphere of every surface's full detail level
+void compute_surface_bounds(MeshData &mesh);
+
+// quadric error edge collapse (Garland and Heckbert 1997) down to
+// target_index_count, never collapsing past target_error. border and seam
+// vertices stay fixed. the reached error is written to result_error
+std::vector<uint32_t> simplify_indices(std::span<const uint32_t> indices,
+                                       std::span<const Vertex> vertices,
+                                       size_t target_index_count,
+                                       float target_error,
+                                       float *result_error = nullptr);
+
+// appends simplified levels for every surface to the mesh indices
+void generate_lods(MeshData &mesh);
+
+// switches the mesh to VertexFormat::Packed when 16 bit positions over its
+// bounds stay within max_quantization_error, returns whether it did
+bool quantize_vertices(MeshData &mesh);
+
+// moves the indices into packed_indices, every surface whose vertex range
+// fits is rebased onto its lowest vertex and stored as 16 bit, all of its
+// levels included
+void pack_indices(MeshData &mesh);
+
+// runs every stage in order
+MeshOptStats optimize_mesh(MeshData &mesh, const MeshOptOptions &options = {});
@@ -1,5 +1,7 @@
 #include "vk_pipelines.h"
 #include "vk_init.h"
+#include "vk_jobs.h"
+#include <cstring>
 #include <fstream>
 
 bool vkutil::loader_shader_module(const char *file_path, VkDevice device,
@@ -39,6 +41,164 @@ bool vkutil::loader_shader_module(const char *file_path, VkDevice device,
     return true;
 }
 
+constexpr uint32_t pipeline_cache_magic = 0x48435047; // "GPCH"
+constexpr uint32_t pipeline_cache_version = 1;
+
+// in front of the driver data. the driver checks its own header too, but
+// not every driver survives data from another driver version
+struct PipelineCacheHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t vendor_id;
+    uint32_t device_id;
+    uint32_t driver_version;
+    uint32_t data_size;
+    uint8_t device_uuid[VK_UUID_SIZE];
+    uint8_t cache_uuid[VK_UUID_SIZE];
+    uint64_t data_hash;
+};
+
+static PipelineCacheHeader device_cache_header(VkPhysicalDevice gpu) {
+    VkPhysicalDeviceIDProperties id_properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_ID_PROPERTIES};
+    VkPhysicalDeviceProperties2 properties = {
+        .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2};
+    properties.pNext = &id_properties;
+    vkGetPhysicalDeviceProperties2(gpu, &properties);
+
+    PipelineCacheHeader header = {};
+    header.magic = pipeline_cache_magic;
+    header.version = pipeline_cache_version;
+    header.vendor_id = properties.properties.vendorID;
+    header.device_id = properties.properties.deviceID;
+    header.driver_version = properties.properties.driverVersion;
+    memcpy(header.device_uuid, id_properties.deviceUUID, VK_UUID_SIZE);
+    memcpy(header.cache_uuid, properties.properties.pipelineCacheUUID,
+           VK_UUID_SIZE);
+
+    return header;
+}
+
+// FNV-1a, only to notice torn or corrupted files
+static uint64_t hash_cache_data(const uint8_t *data, size_t size) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 0x100000001b3;
+    }
+    return hash;
+}
+
+static bool read_pipeline_cache(VkPhysicalDevice gpu,
+                                const std::filesystem::path &path,
+                                std::vector<uint8_t> &data) {
+    std::ifstream file(path, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        return false;
+    }
+
+    size_t file_size = (size_t)file.tellg();
+    if (file_size < sizeof(PipelineCacheHeader)) {
+        return false;
+    }
+
+    PipelineCacheHeader header;
+    file.seekg(0);
+    file.read((char *)&header, sizeof(header));
+
+    PipelineCacheHeader expected = device_cache_header(gpu);
+    if (header.magic != expected.magic || header.version != expected.version ||
+        header.vendor_id != expected.vendor_id ||
+        header.device_id != expected.device_id ||
+        header.driver_version != expected.driver_version ||
+        memcmp(header.device_uuid, expected.device_uuid, VK_UUID_SIZE) != 0 ||
+        memcmp(header.cache_uuid, expected.cache_uuid, VK_UUID_SIZE) != 0 ||
+        header.data_size != file_size - sizeof(header)) {
+        fmt::println("Pipeline cache {} is from another device or driver",
+                     path.string());
+        return false;
+    }
+
+    data.resize(header.data_size);
+    file.read((char *)data.data(), data.size());
+    if (!file || hash_cache_data(data.data(), data.size()) != header.data_hash) {
+        fmt::println("Pipeline cache {} is corrupted", path.string());
+        data.clear();
+        return false;
+    }
+
+    return true;
+}
+
+VkPipelineCache vkutil::load_pipeline_cache(VkDevice device,
+                                            VkPhysicalDevice gpu,
+                                            const std::filesystem::path &path,
+                                            bool *warm) {
+    std::vector<uint8_t> data;
+    bool loaded = read_pipeline_cache(gpu, path, data);
+
+    VkPipelineCacheCreateInfo cache_info = {
+        .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO};
+    cache_info.initialDataSize = data.size();
+    cache_info.pInitialData = data.data();
+
+    VkPipelineCache cache;
+    VkResult err = vkCreatePipelineCache(device, &cache_info, nullptr, &cache);
+    if (err != VK_SUCCESS && loaded) {
+        // the driver turned the data down after all, start over empty
+        loaded = false;
+        cache_info.initialDataSize = 0;
+        cache_info.pInitialData = nullptr;
+        err = vkCreatePipelineCache(device, &cache_info, nullptr, &cache);
+    }
+    VK_CHECK(err);
+
+    if (warm != nullptr) {
+        *warm = loaded;
+    }
+
+    return cache;
+}
+
+bool vkutil::save_pipeline_cache(VkDevice device, VkPhysicalDevice gpu,
+                                 VkPipelineCache cache,
+                                 const std::filesystem::path &path) {
+    size_t data_size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &data_size, nullptr));
+
+    std::vector<uint8_t> blob(sizeof(PipelineCacheHeader) + data_size);
+    uint8_t *data = blob.data() + sizeof(PipelineCacheHeader);
+    VK_CHECK(vkGetPipelineCacheData(device, cache, &data_size, data));
+
+    PipelineCacheHeader header = device_cache_header(gpu);
+    header.data_size = (uint32_t)data_size;
+    header.data_hash = hash_cache_data(data, data_size);
+    memcpy(blob.data(), &header, sizeof(header));
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+
+    // write next to the target and rename so a crash never leaves a torn
+    // cache behind
+    std::filesystem::path tmp_path = path;
+    tmp_path += ".tmp";
+
+    {
+        std::ofstream file(tmp_path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            return false;
+        }
+
+        file.write((const char *)blob.data(),
+                   sizeof(PipelineCacheHeader) + data_size);
+        if (!file) {
+            return false;
+        }
+    }
+
+    std::filesystem::rename(tmp_path, path, ec);
+    return !ec;
+}
+
 void PipelineBuilder::clear() { // c++ will set unassigned parameters to 0
     input_assembly = {
         .sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO};
@@ -54,7 +214,34 @@ void PipelineBuilder::clear() { // c++ will set unassigned parameters to 0
     shader_stages.clear();
 }
 
-VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
+GraphicsPipelineDesc PipelineBuilder::describe() const {
+    GraphicsPipelineDesc desc;
+    desc.shader_stages = shader_stages;
+    desc.input_assembly = input_assembly;
+    desc.rasterizer = rasterizer;
+    desc.color_blend_attachment = color_blend_attachment;
+    desc.multisampling = multisampling;
+    desc.pipeline_layout = pipeline_layout;
+    desc.depth_stencil = depth_stencil;
+    desc.render_info = render_info;
+    desc.color_attachment_format = color_attachment_format;
+    return desc;
+}
+
+VkPipeline PipelineBuilder::build_pipeline(VkDevice device,
+                                           VkPipelineCache cache) {
+    return describe().compile(device, cache);
+}
+
+VkPipeline GraphicsPipelineDesc::compile(VkDevice device,
+                                         VkPipelineCache cache) const {
+    // the builder pointed the format list at its own member, a copy has to
+    // point at the copied format instead
+    VkPipelineRenderingCreateInfo rendering = render_info;
+    if (rendering.colorAttachmentCount > 0) {
+        rendering.pColorAttachmentFormats = &color_attachment_format;
+    }
+
     // no support for multiple viewports or scissors at the moment
     VkPipelineViewportStateCreateInfo viewport_state = {};
     viewport_state.sType =
@@ -80,7 +267,7 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
 
     VkGraphicsPipelineCreateInfo pipeline_info = {
         .sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO};
-    pipeline_info.pNext = &render_info;
+    pipeline_info.pNext = &rendering;
 
     pipeline_info.stageCount = (uint32_t)shader_stages.size();
     pipeline_info.pStages = shader_stages.data();
@@ -105,8 +292,8 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
 
     // error check the pipeline
     VkPipeline new_pipeline;
-    VkResult err = vkCreateGraphicsPipelines(
-        device, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &new_pipeline);
+    VkResult err = vkCreateGraphicsPipelines(device, cache, 1, &pipeline_info,
+                                             nullptr, &new_pipeline);
 
     if (err != VK_SUCCESS) {
         fmt::println("failed to create pipeline");
@@ -116,6 +303,422 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device) {
     }
 }
 
+void ComputePipelineDesc::set_constant(uint32_t id, uint32_t value) {
+    for (const VkSpecializationMapEntry &entry : specialization_entries) {
+        if (entry.constantID == id) {
+            memcpy(specialization_data.data() + entry.offset, &value,
+                   sizeof(value));
+            return;
+        }
+    }
+
+    uint32_t offset = (uint32_t)specialization_data.size();
+    specialization_entries.push_back({id, offset, sizeof(value)});
+    specialization_data.resize(offset + sizeof(value));
+    memcpy(specialization_data.data() + offset, &value, sizeof(value));
+}
+
+VkPipeline ComputePipelineDesc::compile(VkDevice device,
+                                        VkPipelineCache cache) const {
+    VkSpecializationInfo specialization = {};
+    specialization.mapEntryCount = (uint32_t)specialization_entries.size();
+    specialization.pMapEntries = specialization_entries.data();
+    specialization.dataSize = specialization_data.size();
+    specialization.pData = specialization_data.data();
+
+    VkComputePipelineCreateInfo pipeline_info = {
+        .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO};
+    pipeline_info.stage = stage;
+    if (!specialization_entries.empty()) {
+        pipeline_info.stage.pSpecializationInfo = &specialization;
+    }
+    pipeline_info.layout = layout;
+
+    VkPipeline new_pipeline;
+    VkResult err = vkCreateComputePipelines(device, cache, 1, &pipeline_info,
+                                            nullptr, &new_pipeline);
+
+    if (err != VK_SUCCESS) {
+        fmt::println("failed to create compute pipeline");
+        return VK_NULL_HANDLE;
+    } else {
+        return new_pipeline;
+    }
+}
+
+// appends the bytes of value to a registry key. only used on types
+// without padding, so equal state always gives equal bytes
+template <typename T>
+static void append_key(std::string &key, const T &value) {
+    key.append((const char *)&value, sizeof(value));
+}
+
+static void append_specialization_key(std::string &key,
+                                      const VkSpecializationMapEntry *entries,
+                                      uint32_t entry_count, const void *data,
+                                      size_t data_size) {
+    append_key(key, entry_count);
+    for (uint32_t i = 0; i < entry_count; i++) {
+        append_key(key, entries[i].constantID);
+        append_key(key, entries[i].offset);
+        append_key(key, (uint64_t)entries[i].size);
+    }
+    append_key(key, (uint64_t)data_size);
+    if (data_size > 0) {
+        key.append((const char *)data, data_size);
+    }
+}
+
+static void append_stage_key(std::string &key,
+                             const VkPipelineShaderStageCreateInfo &stage) {
+    append_key(key, stage.stage);
+    append_key(key, stage.module);
+    key.append(stage.pName);
+    key.push_back('\0');
+
+    const VkSpecializationInfo *specialization = stage.pSpecializationInfo;
+    if (specialization != nullptr) {
+        append_specialization_key(key, specialization->pMapEntries,
+                                  specialization->mapEntryCount,
+                                  specialization->pData,
+                                  specialization->dataSize);
+    } else {
+        append_specialization_key(key, nullptr, 0, nullptr, 0);
+    }
+}
+
+static std::string pipeline_key(const GraphicsPipelineDesc &desc) {
+    std::string key = "G";
+
+    append_key(key, (uint32_t)desc.shader_stages.size());
+    for (const VkPipelineShaderStageCreateInfo &stage : desc.shader_stages) {
+        append_stage_key(key, stage);
+    }
+
+    append_key(key, desc.input_assembly.topology);
+    append_key(key, desc.input_assembly.primitiveRestartEnable);
+
+    const VkPipelineRasterizationStateCreateInfo &raster = desc.rasterizer;
+    append_key(key, raster.depthClampEnable);
+    append_key(key, raster.rasterizerDiscardEnable);
+    append_key(key, raster.polygonMode);
+    append_key(key, raster.cullMode);
+    append_key(key, raster.frontFace);
+    append_key(key, raster.depthBiasEnable);
+    append_key(key, raster.depthBiasConstantFactor);
+    append_key(key, raster.depthBiasClamp);
+    append_key(key, raster.depthBiasSlopeFactor);
+    append_key(key, raster.lineWidth);
+
+    append_key(key, desc.color_blend_attachment);
+
+    const VkPipelineMultisampleStateCreateInfo &msaa = desc.multisampling;
+    append_key(key, msaa.rasterizationSamples);
+    append_key(key, msaa.sampleShadingEnable);
+    append_key(key, msaa.minSampleShading);
+    append_key(key, msaa.alphaToCoverageEnable);
+    append_key(key, msaa.alphaToOneEnable);
+
+    append_key(key, desc.pipeline_layout);
+
+    const VkPipelineDepthStencilStateCreateInfo &depth = desc.depth_stencil;
+    append_key(key, depth.depthTestEnable);
+    append_key(key, depth.depthWriteEnable);
+    append_key(key, depth.depthCompareOp);
+    append_key(key, depth.depthBoundsTestEnable);
+    append_key(key, depth.stencilTestEnable);
+    append_key(key, depth.front);
+    append_key(key, depth.back);
+    append_key(key, depth.minDepthBounds);
+    append_key(key, depth.maxDepthBounds);
+
+    const VkPipelineRenderingCreateInfo &rendering = desc.render_info;
+    append_key(key, rendering.viewMask);
+    append_key(key, rendering.colorAttachmentCount);
+    if (rendering.colorAttachmentCount > 0) {
+        append_key(key, desc.color_attachment_format);
+    }
+    append_key(key, rendering.depthAttachmentFormat);
+    append_key(key, rendering.stencilAttachmentFormat);
+
+    return key;
+}
+
+static std::string pipeline_key(const ComputePipelineDesc &desc) {
+    std::string key = "C";
+    append_stage_key(key, desc.stage);
+    append_specialization_key(key, desc.specialization_entries.data(),
+                              (uint32_t)desc.specialization_entries.size(),
+                              desc.specialization_data.data(),
+                              desc.specialization_data.size());
+    append_key(key, desc.layout);
+    return key;
+}
+
+bool PipelineRegistry::shader_module(VkDevice device, const char *path,
+                                     VkShaderModule *out_shader_module) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    auto it = shader_modules.find(path);
+    if (it != shader_modules.end()) {
+        counts.shader_module_hits++;
+        *out_shader_module = it->second;
+        return true;
+    }
+
+    if (!vkutil::loader_shader_module(path, device, out_shader_module)) {
+        return false;
+    }
+
+    counts.shader_module_loads++;
+    shader_modules.emplace(path, *out_shader_module);
+    return true;
+}
+
+static std::string pipeline_key(const PipelineDesc &desc) {
+    return std::visit([](const auto &d) { return pipeline_key(d); }, desc);
+}
+
+static VkPipeline compile_pipeline(VkDevice device, VkPipelineCache cache,
+                                   const PipelineDesc &desc) {
+    return std::visit(
+        [&](const auto &d) { return d.compile(device, cache); }, desc);
+}
+
+static bool uses_shader_module(const PipelineDesc &desc,
+                               VkShaderModule module) {
+    if (const auto *graphics = std::get_if<GraphicsPipelineDesc>(&desc)) {
+        for (const VkPipelineShaderStageCreateInfo &stage :
+             graphics->shader_stages) {
+            if (stage.module == module) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    return std::get<ComputePipelineDesc>(desc).stage.module == module;
+}
+
+static void replace_shader_module(PipelineDesc &desc, VkShaderModule from,
+                                  VkShaderModule to) {
+    if (auto *graphics = std::get_if<GraphicsPipelineDesc>(&desc)) {
+        for (VkPipelineShaderStageCreateInfo &stage : graphics->shader_stages) {
+            if (stage.module == from) {
+                stage.module = to;
+            }
+        }
+        return;
+    }
+
+    ComputePipelineDesc &compute = std::get<ComputePipelineDesc>(desc);
+    if (compute.stage.module == from) {
+        compute.stage.module = to;
+    }
+}
+
+VkPipeline PipelineRegistry::get(VkDevice device, VkPipelineCache cache,
+                                 const PipelineDesc &desc, VkPipeline *user) {
+    std::string key = pipeline_key(desc);
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = pipelines.find(key);
+        if (it != pipelines.end()) {
+            counts.hits++;
+            if (user != nullptr) {
+                it->second.users.push_back(user);
+            }
+            return it->second.pipeline;
+        }
+    }
+
+    // compiled unlocked so other keys are not held up. when two threads
+    // race on the same key the loser drops its copy
+    VkPipeline pipeline = compile_pipeline(device, cache, desc);
+    if (pipeline == VK_NULL_HANDLE) {
+        return VK_NULL_HANDLE;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    auto [it, inserted] = pipelines.emplace(key, Entry{pipeline, desc, {}});
+    if (user != nullptr) {
+        it->second.users.push_back(user);
+    }
+
+    if (!inserted) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        counts.hits++;
+        return it->second.pipeline;
+    }
+
+    counts.misses++;
+    return pipeline;
+}
+
+void PipelineRegistry::assign(VkPipeline *user, VkPipeline pipeline) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto &[key, entry] : pipelines) {
+        std::erase(entry.users, user);
+        if (entry.pipeline == pipeline) {
+            entry.users.push_back(user);
+        }
+    }
+
+    *user = pipeline;
+}
+
+bool PipelineRegistry::reload_shader(VkDevice device, VkPipelineCache cache,
+                                     const char *path,
+                                     RetiredPipelineObjects &retired,
+                                     uint32_t *rebuilt_count) {
+    *rebuilt_count = 0;
+
+    VkShaderModule old_module;
+    std::vector<std::string> keys;
+    std::vector<PipelineDesc> descs;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = shader_modules.find(path);
+        if (it == shader_modules.end()) {
+            // never loaded, no pipeline depends on it
+            return true;
+        }
+        old_module = it->second;
+
+        for (const auto &[key, entry] : pipelines) {
+            if (uses_shader_module(entry.desc, old_module)) {
+                keys.push_back(key);
+                descs.push_back(entry.desc);
+            }
+        }
+    }
+
+    VkShaderModule new_module;
+    if (!vkutil::loader_shader_module(path, device, &new_module)) {
+        return false;
+    }
+
+    // built unlocked, a worker helping out may ask the registry for
+    // something else meanwhile
+    std::vector<VkPipeline> rebuilt(descs.size());
+    jobs::parallel_for(descs.size(), [&](size_t i) {
+        replace_shader_module(descs[i], old_module, new_module);
+        rebuilt[i] = compile_pipeline(device, cache, descs[i]);
+    });
+
+    bool failed = false;
+    for (VkPipeline pipeline : rebuilt) {
+        failed |= pipeline == VK_NULL_HANDLE;
+    }
+    if (failed) {
+        for (VkPipeline pipeline : rebuilt) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+        vkDestroyShaderModule(device, new_module, nullptr);
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    for (size_t i = 0; i < keys.size(); i++) {
+        auto node = pipelines.extract(keys[i]);
+        Entry &entry = node.mapped();
+
+        retired.pipelines.push_back(entry.pipeline);
+        entry.pipeline = rebuilt[i];
+        entry.desc = std::move(descs[i]);
+        for (VkPipeline *user : entry.users) {
+            *user = rebuilt[i];
+        }
+
+        // the new module is part of the key
+        node.key() = pipeline_key(entry.desc);
+        auto result = pipelines.insert(std::move(node));
+        if (!result.inserted) {
+            // now equal to a pipeline that was already there, its users
+            // move over to that one
+            Entry &existing = result.position->second;
+            for (VkPipeline *user : result.node.mapped().users) {
+                *user = existing.pipeline;
+                existing.users.push_back(user);
+            }
+            retired.pipelines.push_back(rebuilt[i]);
+        }
+    }
+
+    shader_modules[path] = new_module;
+    retired.shader_modules.push_back(old_module);
+    *rebuilt_count = (uint32_t)keys.size();
+    return true;
+}
+
+PipelineRegistryStats PipelineRegistry::stats() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return counts;
+}
+
+size_t PipelineRegistry::size() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return pipelines.size();
+}
+
+void PipelineRegistry::destroy(VkDevice device) {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    for (auto &[key, entry] : pipelines) {
+        vkDestroyPipeline(device, entry.pipeline, nullptr);
+    }
+    for (auto &[path, module] : shader_modules) {
+        vkDestroyShaderModule(device, module, nullptr);
+    }
+
+    pipelines.clear();
+    shader_modules.clear();
+}
+
+void PipelineBatch::add(GraphicsPipelineDesc desc, VkPipeline *out) {
+    graphics.push_back({std::move(desc), out});
+}
+
+void PipelineBatch::add(ComputePipelineDesc desc, VkPipeline *out) {
+    compute.push_back({std::move(desc), out});
+}
+
+uint32_t PipelineBatch::compile(VkDevice device, VkPipelineCache cache,
+                                PipelineRegistry *registry) {
+    std::atomic<uint32_t> failed{0};
+
+    // one pipeline per iteration, a single driver compile is big enough to
+    // be worth a job of its own
+    size_t graphics_count = graphics.size();
+    jobs::parallel_for(size(), [&](size_t i) {
+        VkPipeline pipeline;
+        if (i < graphics_count) {
+            const GraphicsPipelineDesc &desc = graphics[i].first;
+            pipeline = registry != nullptr
+                           ? registry->get(device, cache, desc,
+                                           graphics[i].second)
+                           : desc.compile(device, cache);
+            *graphics[i].second = pipeline;
+        } else {
+            const auto &[desc, out] = compute[i - graphics_count];
+            pipeline = registry != nullptr
+                           ? registry->get(device, cache, desc, out)
+                           : desc.compile(device, cache);
+            *out = pipeline;
+        }
+
+        if (pipeline == VK_NULL_HANDLE) {
+            failed.fetch_add(1);
+        }
+    });
+
+    graphics.clear();
+    compute.clear();
+
+    return failed.load();
+}
+
 void PipelineBuilder::set_shaders(VkShaderModule vertex_shader,
                                   VkShaderModule fragment_shader) {
     shader_stages.clear();
@@ -177,3 +780,16 @@ void PipelineBuilder::disable_depthtest() {
     depth_stencil.minDepthBounds = 0.f;
     depth_stencil.maxDepthBounds = 1.f;
 }
+
+void PipelineBuilder::enable_depthtest(bool depth_write_enable,
+                                       VkCompareOp op) {
+    depth_stencil.depthTestEnable = VK_TRUE;
+    depth_stencil.depthWriteEnable = depth_write_enable;
+    depth_stencil.depthCompareOp = op;
+    depth_stencil.depthBoundsTestEnable = VK_FALSE;
+    depth_stencil.stencilTestEnable = VK_FALSE;
+    depth_stencil.front = {};
+    depth_stencil.back = {};
+    depth_stencil.minDepthBounds = 0.f;
+    depth_stencil.maxDepthBounds = 1.f;
+}
@@ -1,11 +1,132 @@
 #pragma once
 
 #include "vk_types.h"
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <variant>
 
 namespace vkutil {
     bool loader_shader_module(const char* file_path, VkDevice device, VkShaderModule* out_shader_module);
+
+    // creates a pipeline cache seeded from the file at path. data written
+    // for another device, driver or file version is dropped and the cache
+    // starts empty, warm tells whether anything was loaded
+    VkPipelineCache load_pipeline_cache(VkDevice device, VkPhysicalDevice gpu, const std::filesystem::path& path, bool* warm);
+    bool save_pipeline_cache(VkDevice device, VkPhysicalDevice gpu, VkPipelineCache cache, const std::filesystem::path& path);
 }
 
+// everything one graphics pipeline is built from, copied out of a builder.
+// never changes after describe(), so it can be compiled on any thread
+struct GraphicsPipelineDesc {
+    std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
+
+    VkPipelineInputAssemblyStateCreateInfo input_assembly;
+    VkPipelineRasterizationStateCreateInfo rasterizer;
+    VkPipelineColorBlendAttachmentState color_blend_attachment;
+    VkPipelineMultisampleStateCreateInfo multisampling;
+    VkPipelineLayout pipeline_layout;
+    VkPipelineDepthStencilStateCreateInfo depth_stencil;
+    VkPipelineRenderingCreateInfo render_info;
+    VkFormat color_attachment_format;
+
+    VkPipeline compile(VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE) const;
+};
+
+struct ComputePipelineDesc {
+    VkPipelineShaderStageCreateInfo stage;
+    VkPipelineLayout layout;
+    // specialization constants, owned here so the description can be kept
+    // and compiled again later. compile points the stage at them
+    std::vector<VkSpecializationMapEntry> specialization_entries;
+    std::vector<uint8_t> specialization_data;
+
+    // 32 bit constants only, bools take VK_TRUE or VK_FALSE
+    void set_constant(uint32_t id, uint32_t value);
+    VkPipeline compile(VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE) const;
+};
+
+using PipelineDesc = std::variant<GraphicsPipelineDesc, ComputePipelineDesc>;
+
+// what a shader reload replaced. frames in flight may still use them, so
+// the caller destroys them once those frames are done
+struct RetiredPipelineObjects {
+    std::vector<VkPipeline> pipelines;
+    std::vector<VkShaderModule> shader_modules;
+};
+
+// hit and miss counts of a registry since it was created
+struct PipelineRegistryStats {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t shader_module_hits;
+    uint32_t shader_module_loads;
+};
+
+// owns every pipeline and shader module requested through it. a request
+// whose state hashes equal to an earlier one gets the pipeline built the
+// first time. safe to use from several threads at once
+class PipelineRegistry {
+    public:
+        // loads the SPIR-V at path once. modules stay alive until a reload
+        // retires them or destroy(), so a handle is never reused for other
+        // code and can stand for its shader in the keys
+        bool shader_module(VkDevice device, const char* path, VkShaderModule* out_shader_module);
+
+        // user, when given, is where the caller keeps the pipeline. a reload
+        // writes the rebuilt pipeline there, so it has to outlive the registry
+        VkPipeline get(VkDevice device, VkPipelineCache cache, const PipelineDesc& desc, VkPipeline* user = nullptr);
+        // points user at pipeline, which came from this registry, and stops
+        // writing it for any other pipeline. for switching between variants
+        void assign(VkPipeline* user, VkPipeline pipeline);
+
+        // loads the module at path again and rebuilds every pipeline made
+        // from the old one. if any of them fails nothing changes. only from
+        // the main thread, between frames
+        bool reload_shader(VkDevice device, VkPipelineCache cache, const char* path, RetiredPipelineObjects& retired, uint32_t* rebuilt_count);
+
+        PipelineRegistryStats stats();
+        size_t size();
+
+        void destroy(VkDevice device);
+
+    private:
+        struct Entry {
+            VkPipeline pipeline;
+            PipelineDesc desc;
+            std::vector<VkPipeline*> users;
+        };
+
+        std::mutex mutex;
+        // keyed by the raw bytes of every state that affects the pipeline
+        std::unordered_map<std::string, Entry> pipelines;
+        std::unordered_map<std::string, VkShaderModule> shader_modules;
+        PipelineRegistryStats counts{};
+};
+
+// pipelines to compile together on the job workers. the cache is
+// internally synchronized, so every compile shares it
+class PipelineBatch {
+    public:
+        // out is written by compile(), it has to stay put until then. the
+        // shader modules are not owned, they must outlive compile()
+        void add(GraphicsPipelineDesc desc, VkPipeline* out);
+        void add(ComputePipelineDesc desc, VkPipeline* out);
+
+        // builds everything added and returns once all of it is done.
+        // failed pipelines come back as VK_NULL_HANDLE, the count is returned.
+        // with a registry, repeated state is built once and the registry
+        // owns the pipelines
+        uint32_t compile(VkDevice device, VkPipelineCache cache, PipelineRegistry* registry = nullptr);
+
+        size_t size() const { return graphics.size() + compute.size(); }
+
+    private:
+        std::vector<std::pair<GraphicsPipelineDesc, VkPipeline*>> graphics;
+        std::vector<std::pair<ComputePipelineDesc, VkPipeline*>> compute;
+};
+
 class PipelineBuilder {
     public:
         std::vector<VkPipelineShaderStageCreateInfo> shader_stages;
@@ -23,7 +144,10 @@ class PipelineBuilder {
 
         void clear();
 
-        VkPipeline build_pipeline(VkDevice device);
+        // a snapshot of the current state, the builder can be changed for
+        // the next pipeline right after
+        GraphicsPipelineDesc describe() const;
+        VkPipeline build_pipeline(VkDevice device, VkPipelineCache cache = VK_NULL_HANDLE);
         void set_shaders(VkShaderModule vertex_shader, VkShaderModule fragment_shader);
         void set_input_topology(VkPrimitiveTopology topology);
         void set_polygon_mode(VkPolygonMode mode);
@@ -33,5 +157,6 @@ class PipelineBuilder {
         void set_color_attachment_format(VkFormat format);
         void set_depth_format(VkFormat format);
         void disable_depthtest();
+        void enable_depthtest(bool depth_write_enable, VkCompareOp op);
 };
 
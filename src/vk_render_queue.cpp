@@ -0,0 +1,175 @@
+#include "vk_render_queue.h"
+
+#include <cassert>
+#include <cstring>
+
+uint64_t make_sort_key(uint32_t pipeline, uint32_t descriptor_set,
+                       uint32_t index_buffer, uint32_t draw, float depth) {
+    assert(pipeline < max_sort_key_states);
+    assert(descriptor_set < max_sort_key_states);
+    assert(index_buffer < max_sort_key_states);
+    assert(draw < max_sort_key_draws);
+
+    // non negative floats order like their bits, the top 20 below the sign
+    // keep the exponent and 11 bits of mantissa
+    depth = depth > 0.f ? depth : 0.f;
+    uint32_t depth_bits;
+    memcpy(&depth_bits, &depth, sizeof(depth_bits));
+    depth_bits >>= 31 - sort_key_depth_bits;
+
+    return (uint64_t)pipeline << 56 | (uint64_t)descriptor_set << 48 |
+           (uint64_t)index_buffer << 40 |
+           (uint64_t)draw << sort_key_depth_bits | depth_bits;
+}
+
+uint32_t RenderQueue::pipeline_id(VkPipeline pipeline) {
+    for (uint32_t i = 0; i < pipelines.size(); i++) {
+        if (pipelines[i] == pipeline) {
+            return i;
+        }
+    }
+
+    pipelines.push_back(pipeline);
+    return (uint32_t)pipelines.size() - 1;
+}
+
+uint32_t RenderQueue::descriptor_set_id(VkDescriptorSet set) {
+    if (descriptor_sets.empty()) {
+        descriptor_sets.push_back(VK_NULL_HANDLE);
+    }
+
+    for (uint32_t i = 0; i < descriptor_sets.size(); i++) {
+        if (descriptor_sets[i] == set) {
+            return i;
+        }
+    }
+
+    descriptor_sets.push_back(set);
+    return (uint32_t)descriptor_sets.size() - 1;
+}
+
+uint32_t RenderQueue::index_buffer_id(VkBuffer buffer, VkIndexType type) {
+    for (uint32_t i = 0; i < index_buffers.size(); i++) {
+        if (index_buffers[i].buffer == buffer &&
+            index_buffers[i].type == type) {
+            return i;
+        }
+    }
+
+    index_buffers.push_back({buffer, type});
+    return (uint32_t)index_buffers.size() - 1;
+}
+
+void RenderQueue::sort() {
+    size_t count = entries.size();
+    if (count < 2) {
+        return;
+    }
+
+    // histograms of all 8 digits in one read of the keys
+    uint32_t histograms[8][256] = {};
+    for (const RenderQueueEntry &entry : entries) {
+        for (int d = 0; d < 8; d++) {
+            histograms[d][(entry.key >> (d * 8)) & 0xff]++;
+        }
+    }
+
+    scratch.resize(count);
+    RenderQueueEntry *src = entries.data();
+    RenderQueueEntry *dst = scratch.data();
+
+    for (int d = 0; d < 8; d++) {
+        uint32_t *histogram = histograms[d];
+
+        // a digit every key shares would only copy the entries over
+        if (histogram[(src[0].key >> (d * 8)) & 0xff] == count) {
+            continue;
+        }
+
+        uint32_t offsets[256];
+        uint32_t offset = 0;
+        for (int b = 0; b < 256; b++) {
+            offsets[b] = offset;
+            offset += histogram[b];
+        }
+
+        for (size_t i = 0; i < count; i++) {
+            dst[offsets[(src[i].key >> (d * 8)) & 0xff]++] = src[i];
+        }
+
+        std::swap(src, dst);
+    }
+
+    if (src != entries.data()) {
+        entries.swap(scratch);
+    }
+}
+
+void RenderQueue::find_runs() {
+    runs.clear();
+
+    uint32_t begin = 0;
+    while (begin < entries.size()) {
+        uint64_t draw = sort_key_draw(entries[begin].key);
+        uint32_t end = begin + 1;
+        while (end < entries.size() && sort_key_draw(entries[end].key) == draw) {
+            end++;
+        }
+
+        runs.push_back({begin, end});
+        begin = end;
+    }
+}
+
+void RenderQueue::clear() {
+    entries.clear();
+    runs.clear();
+    pipelines.clear();
+    descriptor_sets.clear();
+    index_buffers.clear();
+}
+
+void BindState::reset() {
+    stats = {};
+    pipeline = VK_NULL_HANDLE;
+    set_layout = VK_NULL_HANDLE;
+    set = VK_NULL_HANDLE;
+    index_buffer = VK_NULL_HANDLE;
+    index_type = VK_INDEX_TYPE_UINT32;
+}
+
+void BindState::bind_pipeline(VkCommandBuffer cmd, VkPipeline pipeline) {
+    if (pipeline == this->pipeline) {
+        return;
+    }
+
+    vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    this->pipeline = pipeline;
+    stats.pipeline_binds++;
+}
+
+void BindState::bind_descriptor_set(VkCommandBuffer cmd,
+                                    VkPipelineLayout layout,
+                                    VkDescriptorSet set) {
+    if (set == VK_NULL_HANDLE || (layout == set_layout && set == this->set)) {
+        return;
+    }
+
+    vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, layout, 0,
+                            1, &set, 0, nullptr);
+    set_layout = layout;
+    this->set = set;
+    stats.descriptor_set_binds++;
+}
+
+void BindState::bind_index_buffer(VkCommandBuffer cmd, VkBuffer buffer,
+                                  VkIndexType type) {
+    if (buffer == index_buffer && type == index_type) {
+        return;
+    }
+
+    vkCmdBindIndexBuffer(cmd, buffer, 0, type);
+    index_buffer = buffer;
+    index_type = type;
+    stats.index_buffer_binds++;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "vk_types.h"
+
+// 64 bit draw sort key, most significant first:
+//   63..56 pipeline
+//   55..48 descriptor set
+//   47..40 index buffer and index type
+//   39..20 draw, surface and level. runs of equal draws become one
+//          instanced call
+//   19..0  view depth, front to back inside a draw
+// state that is expensive to change sorts highest so each value of it is
+// bound once per frame
+constexpr uint32_t sort_key_state_bits = 8;
+constexpr uint32_t sort_key_draw_bits = 20;
+constexpr uint32_t sort_key_depth_bits = 20;
+constexpr uint32_t max_sort_key_states = 1u << sort_key_state_bits;
+constexpr uint32_t max_sort_key_draws = 1u << sort_key_draw_bits;
+
+uint64_t make_sort_key(uint32_t pipeline, uint32_t descriptor_set,
+                       uint32_t index_buffer, uint32_t draw, float depth);
+
+inline uint32_t sort_key_pipeline(uint64_t key) {
+    return (uint32_t)(key >> 56) & 0xff;
+}
+inline uint32_t sort_key_descriptor_set(uint64_t key) {
+    return (uint32_t)(key >> 48) & 0xff;
+}
+inline uint32_t sort_key_index_buffer(uint64_t key) {
+    return (uint32_t)(key >> 40) & 0xff;
+}
+// everything but the depth, equal for entries that draw as one call
+inline uint64_t sort_key_draw(uint64_t key) {
+    return key >> sort_key_depth_bits;
+}
+
+struct RenderQueueEntry {
+    uint64_t key;
+    uint32_t item;
+    uint32_t lod;
+};
+
+// entries [begin, end) only differ in depth and draw as one call
+struct RenderQueueRun {
+    uint32_t begin;
+    uint32_t end;
+};
+
+struct IndexBinding {
+    VkBuffer buffer;
+    VkIndexType type;
+};
+
+// draws of one frame, keyed so that sorting groups them by state
+class RenderQueue {
+  public:
+    std::vector<RenderQueueEntry> entries;
+    std::vector<RenderQueueRun> runs;
+    // what the state ids of the keys stand for, filled on first use after
+    // clear. descriptor set 0 is no set at all
+    std::vector<VkPipeline> pipelines;
+    std::vector<VkDescriptorSet> descriptor_sets;
+    std::vector<IndexBinding> index_buffers;
+
+    uint32_t pipeline_id(VkPipeline pipeline);
+    uint32_t descriptor_set_id(VkDescriptorSet set);
+    uint32_t index_buffer_id(VkBuffer buffer, VkIndexType type);
+
+    void push(uint64_t key, uint32_t item, uint32_t lod) {
+        entries.push_back({key, item, lod});
+    }
+
+    // stable least significant digit radix sort, 8 bits per pass. digits
+    // every key shares are skipped, so the mostly constant state bytes
+    // cost one histogram read each
+    void sort();
+    // fills runs from the entries in their current order
+    void find_runs();
+    void clear();
+
+  private:
+    std::vector<RenderQueueEntry> scratch;
+};
+
+// bind counters of one frame
+struct BindStats {
+    uint32_t pipeline_binds;
+    uint32_t descriptor_set_binds;
+    uint32_t index_buffer_binds;
+};
+
+// graphics bind point state of one command buffer, binds that would not
+// change it are dropped
+class BindState {
+  public:
+    BindStats stats{};
+
+    // forget what is bound, for a new command buffer
+    void reset();
+
+    void bind_pipeline(VkCommandBuffer cmd, VkPipeline pipeline);
+    void bind_descriptor_set(VkCommandBuffer cmd, VkPipelineLayout layout,
+                             VkDescriptorSet set);
+    void bind_index_buffer(VkCommandBuffer cmd, VkBuffer buffer,
+                           VkIndexType type);
+
+  private:
+    VkPipeline pipeline{VK_NULL_HANDLE};
+    VkPipelineLayout set_layout{VK_NULL_HANDLE};
+    VkDescriptorSet set{VK_NULL_HANDLE};
+    VkBuffer index_buffer{VK_NULL_HANDLE};
+    VkIndexType index_type{VK_INDEX_TYPE_UINT32};
+};
@@ -0,0 +1,129 @@
+#include "vk_scene.h"
+#include "vk_jobs.h"
+
+#include <cassert>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GRAPHI_SSE 1
+#endif
+
+// out = a * b for column major matrices, out may not alias a or b
+static void multiply(const glm::mat4 &a, const glm::mat4 &b, glm::mat4 &out) {
+#ifdef GRAPHI_SSE
+    // every output column is the columns of a weighted by one column of b
+    __m128 a0 = _mm_loadu_ps(&a[0].x);
+    __m128 a1 = _mm_loadu_ps(&a[1].x);
+    __m128 a2 = _mm_loadu_ps(&a[2].x);
+    __m128 a3 = _mm_loadu_ps(&a[3].x);
+
+    for (int c = 0; c < 4; c++) {
+        __m128 column = _mm_mul_ps(a0, _mm_set1_ps(b[c][0]));
+        column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_set1_ps(b[c][1])));
+        column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_set1_ps(b[c][2])));
+        column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_set1_ps(b[c][3])));
+        _mm_storeu_ps(&out[c].x, column);
+    }
+#else
+    out = a * b;
+#endif
+}
+
+uint32_t SceneGraph::add_node(const glm::mat4 &transform, uint32_t parent,
+                              int32_t mesh) {
+    uint32_t node = (uint32_t)size();
+
+    // grow the subtree of every ancestor over the new node
+    for (uint32_t p = parent; p != no_parent_node; p = this->parent[p]) {
+        assert(subtree_end[p] == node);
+        subtree_end[p] = node + 1;
+    }
+
+    this->parent.push_back(parent);
+    subtree_end.push_back(node + 1);
+    this->mesh.push_back(mesh);
+    local.push_back(transform);
+    world.push_back(transform);
+    dirty.push_back(1);
+
+    return node;
+}
+
+uint32_t SceneGraph::add_nodes(std::span<const SceneNode> nodes,
+                               uint32_t parent, int32_t mesh_base) {
+    uint32_t first = (uint32_t)size();
+
+    // depth first order, so each parent is still open when its children
+    // arrive
+    for (const SceneNode &node : nodes) {
+        uint32_t node_parent =
+            node.parent == no_parent_node ? parent : first + node.parent;
+        add_node(node.local, node_parent,
+                 node.mesh < 0 ? -1 : mesh_base + node.mesh);
+    }
+
+    return first;
+}
+
+void SceneGraph::set_local(uint32_t node, const glm::mat4 &transform) {
+    local[node] = transform;
+    dirty[node] = 1;
+}
+
+// below this many nodes a dirty update is cheaper than queueing jobs
+constexpr uint32_t min_parallel_update_nodes = 4096;
+
+void SceneGraph::update(std::vector<uint32_t> &changed) {
+    // the topmost dirty nodes, each one takes its whole subtree along
+    std::vector<std::pair<uint32_t, uint32_t>> ranges;
+    uint32_t dirty_count = 0;
+
+    uint32_t node = 0;
+    uint32_t count = (uint32_t)size();
+    while (node < count) {
+        if (!dirty[node]) {
+            node++;
+            continue;
+        }
+
+        ranges.push_back({node, subtree_end[node]});
+        dirty_count += subtree_end[node] - node;
+        node = subtree_end[node];
+    }
+
+    // parents come before children so each parent world is already final
+    // when it is read, and no two ranges share a node
+    auto update_range = [&](size_t r) {
+        for (uint32_t n = ranges[r].first; n < ranges[r].second; n++) {
+            if (parent[n] == no_parent_node) {
+                world[n] = local[n];
+            } else {
+                multiply(world[parent[n]], local[n], world[n]);
+            }
+            dirty[n] = 0;
+        }
+    };
+
+    if (dirty_count >= min_parallel_update_nodes && ranges.size() > 1) {
+        jobs::parallel_for(ranges.size(), update_range);
+    } else {
+        for (size_t r = 0; r < ranges.size(); r++) {
+            update_range(r);
+        }
+    }
+
+    for (const auto &[begin, end] : ranges) {
+        for (uint32_t n = begin; n < end; n++) {
+            changed.push_back(n);
+        }
+    }
+}
+
+void SceneGraph::clear() {
+    parent.clear();
+    subtree_end.clear();
+    mesh.clear();
+    local.clear();
+    world.clear();
+    dirty.clear();
+}
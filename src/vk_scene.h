@@ -0,0 +1,50 @@
+#pragma once
+
+#include "vk_types.h"
+
+constexpr uint32_t no_parent_node = ~0u;
+
+// one node as imported, parents always come before their children
+struct SceneNode {
+    glm::mat4 local;
+    // index into the same node array, no_parent_node for roots
+    uint32_t parent;
+    // index into the meshes of the same asset, -1 for pure transforms
+    int32_t mesh;
+    uint32_t pad[2];
+};
+
+// node hierarchy flattened into parallel arrays in depth first order. every
+// subtree is the contiguous range [node, subtree_end[node]), so one linear
+// pass updates world transforms and skips clean subtrees whole
+class SceneGraph {
+  public:
+    std::vector<uint32_t> parent;
+    std::vector<uint32_t> subtree_end;
+    // index into the engine meshes, -1 for pure transforms
+    std::vector<int32_t> mesh;
+    std::vector<glm::mat4> local;
+    std::vector<glm::mat4> world;
+    // set by set_local, cleared by update
+    std::vector<uint8_t> dirty;
+
+    // appends a node as the last child of parent, which has to be the most
+    // recently added node or one of its ancestors so subtrees stay
+    // contiguous. returns the index of the node
+    uint32_t add_node(const glm::mat4 &transform, uint32_t parent,
+                      int32_t mesh = -1);
+    // appends imported nodes under parent, their mesh indices offset by
+    // mesh_base. returns the index of the first one
+    uint32_t add_nodes(std::span<const SceneNode> nodes, uint32_t parent,
+                       int32_t mesh_base);
+
+    void set_local(uint32_t node, const glm::mat4 &transform);
+
+    // recomputes world for every dirty node and everything below it and
+    // appends the nodes that got a new world to changed. independent dirty
+    // subtrees update on the job workers once there are enough nodes
+    void update(std::vector<uint32_t> &changed);
+
+    void clear();
+    size_t size() const { return parent.size(); }
+};
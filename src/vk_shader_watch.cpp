@@ -0,0 +1,107 @@
+#include "vk_shader_watch.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fmt/core.h>
+
+#ifdef __linux__
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+bool ShaderWatcher::init(const std::filesystem::path &dir) {
+#ifdef __linux__
+    this->dir = dir;
+
+    fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    // compilers and editors either write in place or rename a finished
+    // temporary over the file, both end in one of these
+    watch = inotify_add_watch(fd, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (watch < 0) {
+        destroy();
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void ShaderWatcher::destroy() {
+#ifdef __linux__
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+    fd = -1;
+    watch = -1;
+}
+
+std::vector<std::filesystem::path> ShaderWatcher::poll() {
+    std::vector<std::filesystem::path> changed;
+
+#ifdef __linux__
+    if (fd < 0) {
+        return changed;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while (true) {
+        ssize_t size = read(fd, buffer, sizeof(buffer));
+        if (size <= 0) {
+            break;
+        }
+
+        for (char *p = buffer; p < buffer + size;) {
+            const inotify_event *event = (const inotify_event *)p;
+            if (event->len > 0) {
+                changed.push_back(dir / event->name);
+            }
+            p += sizeof(inotify_event) + event->len;
+        }
+    }
+
+    // a save can arrive as several events
+    std::sort(changed.begin(), changed.end());
+    changed.erase(std::unique(changed.begin(), changed.end()), changed.end());
+#endif
+
+    return changed;
+}
+
+bool is_glsl_source(const std::filesystem::path &path) {
+    std::filesystem::path ext = path.extension();
+    return ext == ".vert" || ext == ".frag" || ext == ".comp";
+}
+
+bool compile_glsl(const std::filesystem::path &source) {
+#ifdef GRAPHI_GLSL_VALIDATOR
+    std::filesystem::path spv = source;
+    spv += ".spv";
+    std::filesystem::path tmp = spv;
+    tmp += ".tmp";
+
+    // written beside the target and renamed over it, so a watcher never
+    // loads a half written module and a failed compile keeps the old one
+    std::string command = fmt::format("\"{}\" -V \"{}\" -o \"{}\"",
+                                      GRAPHI_GLSL_VALIDATOR, source.string(),
+                                      tmp.string());
+    std::error_code ec;
+    if (std::system(command.c_str()) != 0) {
+        std::filesystem::remove(tmp, ec);
+        return false;
+    }
+
+    std::filesystem::rename(tmp, spv, ec);
+    return !ec;
+#else
+    fmt::println("No GLSL compiler configured, cannot compile {}",
+                 source.string());
+    return false;
+#endif
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+// reports files written into one directory, without blocking. built on
+// inotify, on other platforms init fails and nothing is ever reported
+class ShaderWatcher {
+  public:
+    bool init(const std::filesystem::path &dir);
+    void destroy();
+
+    // files closed after writing or moved into the directory since the last
+    // poll, each path once
+    std::vector<std::filesystem::path> poll();
+
+  private:
+    std::filesystem::path dir;
+    int fd{-1};
+    int watch{-1};
+};
+
+// whether the file is GLSL source the Shaders target compiles
+bool is_glsl_source(const std::filesystem::path &path);
+// runs the GLSL compiler on source, writing source.spv next to it.
+// returns false when it failed or no compiler was found at build time
+bool compile_glsl(const std::filesystem::path &source);
@@ -52,13 +52,168 @@ struct Vertex {
     glm::vec4 color;
 };
 
+// 20 byte quantized Vertex, decoded in mesh_instanced_packed.vert
+struct PackedVertex {
+    // unorm16 x/y/z relative to the mesh bounds, z in the low half
+    uint32_t position_xy;
+    uint32_t position_z;
+    // octahedral encoded, snorm16 x2
+    uint32_t normal;
+    // half float x2
+    uint32_t uv;
+    // unorm8 x4
+    uint32_t color;
+};
+
+// full detail plus up to three simplified levels
+constexpr uint32_t max_lod_count = 4;
+
+// axis aligned box plus bounding sphere around the box center
+struct Bounds {
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::vec3 center;
+    float radius;
+};
+
+constexpr uint32_t max_meshlet_vertices = 64;
+constexpr uint32_t max_meshlet_triangles = 124;
+
+// small cluster of a surface's full detail triangles, laid out std430 so
+// culling shaders can read the array as is
+struct Meshlet {
+    // bounding sphere in mesh units
+    glm::vec3 center;
+    float radius;
+    // every triangle faces away from a viewer at v when
+    // dot(center - v, cone_axis) >= cone_cutoff * length(center - v) + radius
+    glm::vec3 cone_axis;
+    float cone_cutoff;
+    // counted in elements of the surface index type from the start of the
+    // surface's full detail range
+    uint32_t index_offset;
+    uint32_t triangle_count;
+    uint32_t vertex_count;
+    uint32_t pad;
+};
+
+enum class VertexFormat : uint32_t {
+    Full,
+    // PackedVertex, positions go through GPUMeshBuffers::dequantize
+    Packed,
+};
+
+constexpr size_t vertex_stride(VertexFormat format) {
+    return format == VertexFormat::Packed ? sizeof(PackedVertex)
+                                          : sizeof(Vertex);
+}
+
+constexpr size_t index_size(VkIndexType type) {
+    return type == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+// timeline value an asynchronous upload signals once its copies have landed
+struct UploadHandle {
+    uint64_t value{0};
+};
+
 struct GPUMeshBuffers {
-    AllocatedBuffer index_buffer;
-    AllocatedBuffer vertex_buffer;
+    // byte ranges inside a MeshArena block, the buffers are shared
+    uint32_t arena_block;
+    VkDeviceSize vertex_offset;
+    VkDeviceSize vertex_size;
+    VkDeviceSize index_offset;
+    VkDeviceSize index_size;
+
+    VkBuffer index_buffer;
+    // address of the whole block, draws offset into it with base_vertex
     VkDeviceAddress vertex_buffer_address;
+    // in uint32 elements, surfaces with 16 bit indices compute their own
+    uint32_t first_index;
+    int32_t base_vertex;
+    UploadHandle upload;
+
+    VertexFormat vertex_format;
+    // maps packed unorm positions back to mesh space, identity otherwise
+    glm::mat4 dequantize;
+
+    // Meshlet array of the mesh, stored in the same block as the vertices
+    VkDeviceSize meshlet_offset;
+    VkDeviceSize meshlet_size;
+    VkDeviceAddress meshlet_buffer_address;
 };
 
 struct GPUDrawPushConstants {
     glm::mat4 world_matrix;
     VkDeviceAddress vertex_buffer;
 };
+
+// per instance data of the instanced mesh path, std430
+struct GPUInstanceData {
+    glm::mat4 world;
+};
+
+struct GPUInstancedPushConstants {
+    glm::mat4 view_proj;
+    VkDeviceAddress vertex_buffer;
+    // GPUInstanceData, indexed with gl_InstanceIndex
+    VkDeviceAddress instance_buffer;
+};
+
+// one drawable surface as the culling shader sees it, std430
+struct GPUDrawObject {
+    // applied to the decoded vertex positions, includes dequantization
+    glm::mat4 world;
+    // world space center and radius
+    glm::vec4 sphere;
+    // per level first index into the arena index buffer, index count and
+    // world space error
+    uint32_t lod_first_index[max_lod_count];
+    uint32_t lod_index_count[max_lod_count];
+    float lod_error[max_lod_count];
+    int32_t base_vertex;
+    uint32_t lod_count;
+    // draws of one bucket share an index buffer, index type and vertex
+    // buffer, the bucket's commands start at command_base
+    uint32_t bucket;
+    uint32_t command_base;
+    VertexFormat vertex_format;
+    uint32_t pad[3];
+};
+
+// written by the cpu every frame, read by cull.comp
+struct GPUCullParams {
+    glm::vec4 frustum[6];
+    // xyz camera position, w pixel scale
+    glm::vec4 camera;
+    glm::mat4 view;
+    // P00, P11, P22 and P32 of the projection
+    glm::vec4 projection;
+    float pyramid_width;
+    float pyramid_height;
+    float znear;
+    uint32_t object_count;
+    float lod_pixel_error;
+    uint32_t occlusion_culling;
+    uint32_t pad[2];
+};
+
+struct GPUCullPushConstants {
+    VkDeviceAddress params;
+    VkDeviceAddress objects;
+    VkDeviceAddress commands;
+    VkDeviceAddress counts;
+    // one uint per object, set when it passed the last late pass
+    VkDeviceAddress visibility;
+    // 0 draws what was visible last frame, 1 tests everything against
+    // the depth pyramid and draws what the first pass missed
+    uint32_t late;
+    uint32_t pad;
+};
+
+struct GPUIndirectPushConstants {
+    glm::mat4 view_proj;
+    VkDeviceAddress objects;
+    // the same block address, read as Vertex or PackedVertex per object
+    VkDeviceAddress vertex_buffer;
+};
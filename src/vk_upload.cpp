@@ -0,0 +1,255 @@
+#include "vk_upload.h"
+#include "vk_init.h"
+
+#include <cstring>
+
+// keeps every staged block aligned for buffer and texel copies
+constexpr size_t staging_alignment = 16;
+// ring_begin of a batch that only used oversized buffers
+constexpr size_t no_ring = SIZE_MAX;
+
+static AllocatedBuffer create_staging_buffer(VmaAllocator alloc, size_t size) {
+    VkBufferCreateInfo buffer_info = {.sType =
+                                          VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO};
+    buffer_info.pNext = nullptr;
+
+    buffer_info.size = size;
+    buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+    VmaAllocationCreateInfo vma_alloc_info = {};
+    vma_alloc_info.usage = VMA_MEMORY_USAGE_CPU_ONLY;
+    vma_alloc_info.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+
+    AllocatedBuffer new_buffer;
+    VK_CHECK(vmaCreateBuffer(alloc, &buffer_info, &vma_alloc_info,
+                             &new_buffer.buffer, &new_buffer.allocation,
+                             &new_buffer.info));
+
+    return new_buffer;
+}
+
+void UploadBatcher::init(VkDevice device, VmaAllocator alloc, VkQueue queue,
+                         uint32_t queue_family, size_t staging_size) {
+    this->device = device;
+    this->alloc = alloc;
+    this->queue = queue;
+    this->staging_size = staging_size;
+
+    VkCommandPoolCreateInfo command_pool_info =
+        vkinit::command_pool_create_info(
+            queue_family, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
+    VK_CHECK(
+        vkCreateCommandPool(device, &command_pool_info, nullptr, &command_pool));
+
+    VkSemaphoreTypeCreateInfo timeline_info = {
+        .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO};
+    timeline_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timeline_info.initialValue = 0;
+
+    VkSemaphoreCreateInfo semaphore_create_info =
+        vkinit::semaphore_create_info(0);
+    semaphore_create_info.pNext = &timeline_info;
+    VK_CHECK(vkCreateSemaphore(device, &semaphore_create_info, nullptr,
+                               &timeline_semaphore));
+
+    staging = create_staging_buffer(alloc, staging_size);
+    staging_head = 0;
+}
+
+void UploadBatcher::destroy() {
+    flush();
+    retire();
+
+    vmaDestroyBuffer(alloc, staging.buffer, staging.allocation);
+    vkDestroySemaphore(device, timeline_semaphore, nullptr);
+    vkDestroyCommandPool(device, command_pool, nullptr);
+}
+
+void UploadBatcher::begin() {
+    if (recording) {
+        return;
+    }
+
+    VkCommandBuffer cmd;
+    if (free_cmds.empty()) {
+        VkCommandBufferAllocateInfo cmd_alloc_info =
+            vkinit::command_buffer_allocate_info(command_pool, 1);
+        VK_CHECK(vkAllocateCommandBuffers(device, &cmd_alloc_info, &cmd));
+    } else {
+        cmd = free_cmds.back();
+        free_cmds.pop_back();
+    }
+
+    VK_CHECK(vkResetCommandBuffer(cmd, 0));
+
+    VkCommandBufferBeginInfo cmd_begin_info = vkinit::command_buffer_begin_info(
+        VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+    VK_CHECK(vkBeginCommandBuffer(cmd, &cmd_begin_info));
+
+    recording = Batch{cmd, last_submitted + 1, no_ring, {}};
+}
+
+void UploadBatcher::retire() {
+    uint64_t done;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline_semaphore, &done));
+
+    while (!in_flight.empty() && in_flight.front().value <= done) {
+        Batch &batch = in_flight.front();
+
+        for (const AllocatedBuffer &big : batch.oversized) {
+            vmaDestroyBuffer(alloc, big.buffer, big.allocation);
+        }
+        free_cmds.push_back(batch.cmd);
+
+        in_flight.pop_front();
+    }
+}
+
+std::optional<size_t> UploadBatcher::allocate(size_t size) {
+    // start of the oldest ring region a batch still owns
+    std::optional<size_t> tail;
+    for (const Batch &batch : in_flight) {
+        if (batch.ring_begin != no_ring) {
+            tail = batch.ring_begin;
+            break;
+        }
+    }
+    if (!tail && recording && recording->ring_begin != no_ring) {
+        tail = recording->ring_begin;
+    }
+
+    if (!tail) {
+        staging_head = 0;
+        return size <= staging_size ? std::optional<size_t>{0} : std::nullopt;
+    }
+
+    size_t offset = (staging_head + staging_alignment - 1) &
+                    ~(staging_alignment - 1);
+
+    // allocations never end exactly on the tail so that head == tail can
+    // only mean the ring is empty
+    if (staging_head >= *tail) {
+        if (offset + size <= staging_size) {
+            return offset;
+        }
+        if (size < *tail) {
+            return 0;
+        }
+        return {};
+    }
+
+    if (offset + size < *tail) {
+        return offset;
+    }
+    return {};
+}
+
+std::pair<VkBuffer, VkDeviceSize> UploadBatcher::stage(const void *data,
+                                                       size_t size) {
+    if (size > staging_size) {
+        AllocatedBuffer big = create_staging_buffer(alloc, size);
+        memcpy(big.info.pMappedData, data, size);
+
+        begin();
+        recording->oversized.push_back(big);
+        return {big.buffer, 0};
+    }
+
+    std::optional<size_t> offset = allocate(size);
+    while (!offset) {
+        // ring is full, wait for the oldest batch to hand its space back.
+        // submit retires what already finished, which can include the
+        // batch it just queued, so in_flight may still be empty after it
+        if (in_flight.empty()) {
+            submit();
+        }
+        if (!in_flight.empty()) {
+            wait(UploadHandle{in_flight.front().value});
+            retire();
+        }
+
+        offset = allocate(size);
+    }
+
+    begin();
+    if (recording->ring_begin == no_ring) {
+        recording->ring_begin = *offset;
+    }
+
+    memcpy((char *)staging.info.pMappedData + *offset, data, size);
+    staging_head = *offset + size;
+
+    return {staging.buffer, *offset};
+}
+
+UploadHandle UploadBatcher::upload_buffer(VkBuffer dst,
+                                          VkDeviceSize dst_offset,
+                                          const void *data, size_t size) {
+    if (size == 0) {
+        return UploadHandle{recording ? recording->value : last_submitted};
+    }
+
+    auto [src, src_offset] = stage(data, size);
+
+    VkBufferCopy copy{0};
+    copy.srcOffset = src_offset;
+    copy.dstOffset = dst_offset;
+    copy.size = size;
+
+    vkCmdCopyBuffer(recording->cmd, src, dst, 1, &copy);
+
+    return UploadHandle{recording->value};
+}
+
+UploadHandle UploadBatcher::submit() {
+    if (!recording) {
+        retire();
+        return UploadHandle{last_submitted};
+    }
+
+    VK_CHECK(vkEndCommandBuffer(recording->cmd));
+
+    VkCommandBufferSubmitInfo cmd_info =
+        vkinit::command_buffer_submit_info(recording->cmd);
+
+    VkSemaphoreSubmitInfo signal_info = vkinit::semaphore_submit_info(
+        VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, timeline_semaphore);
+    signal_info.value = recording->value;
+
+    VkSubmitInfo2 batch_submit =
+        vkinit::submit_info(&cmd_info, &signal_info, nullptr);
+
+    VK_CHECK(vkQueueSubmit2(queue, 1, &batch_submit, VK_NULL_HANDLE));
+
+    submit_count++;
+    last_submitted = recording->value;
+
+    in_flight.push_back(std::move(*recording));
+    recording.reset();
+
+    retire();
+
+    return UploadHandle{last_submitted};
+}
+
+void UploadBatcher::flush() {
+    wait(submit());
+    retire();
+}
+
+bool UploadBatcher::is_complete(UploadHandle handle) {
+    uint64_t done;
+    VK_CHECK(vkGetSemaphoreCounterValue(device, timeline_semaphore, &done));
+
+    return done >= handle.value;
+}
+
+void UploadBatcher::wait(UploadHandle handle) {
+    VkSemaphoreWaitInfo wait_info = {.sType =
+                                         VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO};
+    wait_info.semaphoreCount = 1;
+    wait_info.pSemaphores = &timeline_semaphore;
+    wait_info.pValues = &handle.value;
+
+    VK_CHECK(vkWaitSemaphores(device, &wait_info, UINT64_MAX));
+}
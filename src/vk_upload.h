@@ -0,0 +1,66 @@
+#pragma once
+
+#include "vk_types.h"
+
+// collects buffer copies into one persistently mapped staging ring and
+// submits them together instead of one queue submit per upload.
+// batches run asynchronously on the given queue, each one signals the next
+// value of a timeline semaphore when its copies have landed
+class UploadBatcher {
+  public:
+    // number of queue submissions done so far, for load time stats
+    uint32_t submit_count{0};
+
+    void init(VkDevice device, VmaAllocator alloc, VkQueue queue,
+              uint32_t queue_family, size_t staging_size);
+    void destroy();
+
+    // copies data into the ring and records the copy, submits on its own
+    // when the ring runs out of space. the returned handle is signalled once
+    // the batch holding the copy has finished
+    UploadHandle upload_buffer(VkBuffer dst, VkDeviceSize dst_offset,
+                               const void *data, size_t size);
+
+    // submits everything recorded so far without waiting
+    UploadHandle submit();
+    // submits everything recorded so far and waits for the copies to land
+    void flush();
+
+    bool is_complete(UploadHandle handle);
+    void wait(UploadHandle handle);
+
+    VkSemaphore timeline() const { return timeline_semaphore; }
+    // value the timeline reaches once every submitted batch has finished
+    uint64_t submitted_value() const { return last_submitted; }
+
+  private:
+    struct Batch {
+        VkCommandBuffer cmd;
+        uint64_t value;
+        size_t ring_begin;
+        // payloads bigger than the ring get their own buffer
+        std::vector<AllocatedBuffer> oversized;
+    };
+
+    VkDevice device;
+    VmaAllocator alloc;
+    VkQueue queue;
+    VkCommandPool command_pool;
+    VkSemaphore timeline_semaphore;
+    uint64_t last_submitted{0};
+
+    std::deque<Batch> in_flight;
+    std::vector<VkCommandBuffer> free_cmds;
+    std::optional<Batch> recording;
+
+    AllocatedBuffer staging;
+    size_t staging_size{0};
+    size_t staging_head{0};
+
+    // returns the staging buffer and offset the data was written to
+    std::pair<VkBuffer, VkDeviceSize> stage(const void *data, size_t size);
+    std::optional<size_t> allocate(size_t size);
+    void begin();
+    // recycles the batches the gpu is done with
+    void retire();
+};
@@ -18,8 +18,13 @@ void vkutil::transition_img(VkCommandBuffer cmd, VkImage img,
     img_barrier.oldLayout = curr_layout;
     img_barrier.newLayout = new_layout;
 
+    auto is_depth = [](VkImageLayout layout) {
+        return layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL ||
+               layout == VK_IMAGE_LAYOUT_DEPTH_READ_ONLY_OPTIMAL;
+    };
+
     VkImageAspectFlags aspect_mask;
-    if (new_layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) {
+    if (is_depth(new_layout) || is_depth(curr_layout)) {
         aspect_mask = VK_IMAGE_ASPECT_DEPTH_BIT;
     } else {
         aspect_mask = VK_IMAGE_ASPECT_COLOR_BIT;